@@ -0,0 +1,245 @@
+#include "MockServices.h"
+#include "BlueZ.h"
+#include "Common.h"
+#include "Config.h"
+#include "DBus.h"
+#include "SNI.h"
+
+#include <gio/gio.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <time.h>
+#include <vector>
+
+// Runs the tray and Bluetooth code of gBar against MockServices on a private dbus-daemon, without a display, and reports
+// CPU time, latency and d-bus message counts. Built from the gBar sources it drives, see meson.build.
+
+static const char* usage = "Usage: gBarDBusBench [--devices=N] [--flap-hz=X] [--items=N] [--icon-size=N] [--new-icon-hz=X] [--warmup=S] "
+                           "[--duration=S] [--verbose]\n";
+
+static int64_t CPUTimeUs(clockid_t clock)
+{
+    timespec time{};
+    clock_gettime(clock, &time);
+    return (int64_t)time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}
+
+struct Snapshot
+{
+    int64_t time = 0;
+    // All of gBar's code runs on the main thread
+    int64_t mainCPUUs = 0;
+    int64_t mockCPUUs = 0;
+    // Also the gdbus worker thread, which reads and writes the messages of gBar and the mocks
+    int64_t processCPUUs = 0;
+    DBus::MessageStats system;
+    DBus::MessageStats session;
+    uint64_t flaps = 0;
+    uint64_t newIcons = 0;
+    uint64_t iconFetches = 0;
+    uint64_t tableUpdates = 0;
+};
+
+static GMainLoop* loop = nullptr;
+static int64_t measureStart = INT64_MAX;
+static Snapshot begin;
+static std::vector<uint64_t> flapLatenciesUs;
+static uint32_t lastRevision = 0;
+static uint64_t tableUpdates = 0;
+
+static Snapshot TakeSnapshot()
+{
+    const MockServices::Stats& mockStats = MockServices::GetStats();
+    Snapshot snapshot;
+    snapshot.time = g_get_monotonic_time();
+    snapshot.mainCPUUs = CPUTimeUs(CLOCK_THREAD_CPUTIME_ID);
+    snapshot.mockCPUUs = MockServices::GetCPUTimeUs();
+    snapshot.processCPUUs = CPUTimeUs(CLOCK_PROCESS_CPUTIME_ID);
+    snapshot.system = DBus::GetMessageStats(DBus::Bus::System);
+    snapshot.session = DBus::GetMessageStats(DBus::Bus::Session);
+    snapshot.flaps = mockStats.flaps;
+    snapshot.newIcons = mockStats.newIcons;
+    snapshot.iconFetches = mockStats.iconFetches;
+    snapshot.tableUpdates = tableUpdates;
+    return snapshot;
+}
+
+static void PrintLatencies(const char* what, std::vector<uint64_t> samples)
+{
+    if (samples.empty())
+    {
+        printf("  %s: No samples\n", what);
+        return;
+    }
+    std::sort(samples.begin(), samples.end());
+    uint64_t total = 0;
+    for (uint64_t sample : samples)
+    {
+        total += sample;
+    }
+    printf("  %s: avg %luus, p50 %luus, p99 %luus, max %luus (%zu samples)\n", what, (unsigned long)(total / samples.size()),
+           (unsigned long)samples[samples.size() / 2], (unsigned long)samples[samples.size() * 99 / 100], (unsigned long)samples.back(),
+           samples.size());
+}
+
+int main(int argc, char** argv)
+{
+    MockServices::Params params;
+    double warmup = 2;
+    double duration = 10;
+    bool verbose = false;
+    for (int i = 1; i < argc; i++)
+    {
+        auto value = [&](const char* name) -> const char*
+        {
+            size_t len = strlen(name);
+            return strncmp(argv[i], name, len) == 0 && argv[i][len] == '=' ? argv[i] + len + 1 : nullptr;
+        };
+        if (const char* v = value("--devices"))
+            params.numDevices = atoi(v);
+        else if (const char* v = value("--flap-hz"))
+            params.flapHz = atof(v);
+        else if (const char* v = value("--items"))
+            params.numItems = atoi(v);
+        else if (const char* v = value("--icon-size"))
+            params.iconSize = std::max(atoi(v), 1);
+        else if (const char* v = value("--new-icon-hz"))
+            params.newIconHz = atof(v);
+        else if (const char* v = value("--warmup"))
+            warmup = atof(v);
+        else if (const char* v = value("--duration"))
+            duration = atof(v);
+        else if (strcmp(argv[i], "--verbose") == 0)
+            verbose = true;
+        else
+        {
+            fprintf(stderr, "%s", usage);
+            return 1;
+        }
+    }
+
+    char* daemon = g_find_program_in_path("dbus-daemon");
+    if (!daemon)
+    {
+        fprintf(stderr, "dbus-daemon not found, skipping\n");
+        // Skipped, for meson
+        return 77;
+    }
+    g_free(daemon);
+
+    // Serves as session and system bus. gio honours the environment variables.
+    GTestDBus* testBus = g_test_dbus_new(G_TEST_DBUS_NONE);
+    g_test_dbus_up(testBus);
+    params.address = g_test_dbus_get_bus_address(testBus);
+    g_setenv("DBUS_SYSTEM_BUS_ADDRESS", params.address.c_str(), true);
+
+    if (!MockServices::Start(params))
+    {
+        fprintf(stderr, "Can't start the mock services\n");
+        g_test_dbus_down(testBus);
+        return 1;
+    }
+
+    // The same code paths as in the bar, minus the widgets
+    BlueZ::Init();
+    SNI::Init();
+    if (!RuntimeConfig::Get().hasBlueZ || !RuntimeConfig::Get().hasSNI)
+    {
+        fprintf(stderr, "BlueZ or SNI didn't start\n");
+        MockServices::Stop();
+        g_test_dbus_down(testBus);
+        return 1;
+    }
+
+    // Subscribed after BlueZ, so it runs once BlueZ has applied the change
+    DBus::SubscriptionID latencyID = DBus::Subscribe(DBus::Bus::System, "org.bluez", "org.freedesktop.DBus.Properties", "PropertiesChanged", nullptr,
+                                                     [](const char*, const char*, const char*, const char*, GVariant* params)
+                                                     {
+                                                         GVariant* changed = g_variant_get_child_value(params, 1);
+                                                         gint64 sent = 0;
+                                                         if (g_variant_lookup(changed, MockServices::sentKey, "x", &sent) && sent >= measureStart)
+                                                         {
+                                                             flapLatenciesUs.push_back(g_get_monotonic_time() - sent);
+                                                         }
+                                                         g_variant_unref(changed);
+                                                     });
+    // Like the Bluetooth widget of the bar
+    g_timeout_add(
+        100,
+        [](void*) -> gboolean
+        {
+            uint32_t revision = BlueZ::GetInfo().revision;
+            if (revision != lastRevision)
+            {
+                lastRevision = revision;
+                tableUpdates++;
+            }
+            return G_SOURCE_CONTINUE;
+        },
+        nullptr);
+
+    loop = g_main_loop_new(nullptr, false);
+    // Items register and are queried during the warmup
+    g_timeout_add(
+        warmup * 1000,
+        [](void*) -> gboolean
+        {
+            measureStart = g_get_monotonic_time();
+            MockServices::SetMeasureStart(measureStart);
+            begin = TakeSnapshot();
+            return G_SOURCE_REMOVE;
+        },
+        nullptr);
+    g_timeout_add(
+        (warmup + duration) * 1000,
+        [](void*) -> gboolean
+        {
+            g_main_loop_quit(loop);
+            return G_SOURCE_REMOVE;
+        },
+        nullptr);
+
+    // gBar logs every icon it loads, which would dominate the numbers
+    if (!verbose)
+    {
+        std::cout.setstate(std::ios::badbit);
+    }
+    g_main_loop_run(loop);
+    Snapshot end = TakeSnapshot();
+
+    DBus::Unsubscribe(latencyID);
+    SNI::Shutdown();
+    BlueZ::Shutdown();
+    MockServices::Stop();
+
+    double seconds = (end.time - begin.time) / 1000000.0;
+    auto perSecond = [&](uint64_t count)
+    {
+        return count / seconds;
+    };
+    printf("%u devices flapping %.1f/s each, %u items with %dx%d icons sending NewIcon %.1f/s each, %.1fs\n", params.numDevices, params.flapHz,
+           params.numItems, params.iconSize, params.iconSize, params.newIconHz, seconds);
+    printf("CPU time: gBar (main thread) %.1fms (%.2f%% of a core), mocks %.1fms, whole process %.1fms\n", (end.mainCPUUs - begin.mainCPUUs) / 1000.0,
+           (end.mainCPUUs - begin.mainCPUUs) / 10000.0 / seconds, (end.mockCPUUs - begin.mockCPUUs) / 1000.0,
+           (end.processCPUUs - begin.processCPUUs) / 1000.0);
+    printf("Messages of gBar: system bus %.1f/s in, %.1f/s out; session bus %.1f/s in, %.1f/s out\n", perSecond(end.system.in - begin.system.in),
+           perSecond(end.system.out - begin.system.out), perSecond(end.session.in - begin.session.in), perSecond(end.session.out - begin.session.out));
+    printf("BlueZ: %lu changes sent, %lu device table updates seen every 100ms\n", (unsigned long)(end.flaps - begin.flaps),
+           (unsigned long)(end.tableUpdates - begin.tableUpdates));
+    PrintLatencies("Signal until the device table is up to date", flapLatenciesUs);
+    printf("SNI: %lu NewIcon sent, %lu IconPixmap fetches\n", (unsigned long)(end.newIcons - begin.newIcons),
+           (unsigned long)(end.iconFetches - begin.iconFetches));
+    PrintLatencies("NewIcon until the icon is fetched", MockServices::GetStats().fetchLatenciesUs);
+
+    if (verbose)
+    {
+        DBus::LogStats();
+    }
+    DBus::Shutdown();
+    g_main_loop_unref(loop);
+    g_test_dbus_down(testBus);
+    g_object_unref(testBus);
+    return 0;
+}
@@ -0,0 +1,471 @@
+#include "MockServices.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <pthread.h>
+#include <thread>
+#include <time.h>
+
+namespace MockServices
+{
+    static Params params;
+    static Stats stats;
+    static std::atomic<int64_t> measureStart{INT64_MAX};
+
+    static std::thread thread;
+    static GMainContext* context = nullptr;
+    static GMainLoop* loop = nullptr;
+
+    static std::mutex readyMutex;
+    static std::condition_variable readyCond;
+    // 0 while starting, 1 when running, -1 on failure
+    static int ready = 0;
+
+    static const char* objectManagerXML = R"xml(
+<node>
+    <interface name="org.freedesktop.DBus.ObjectManager">
+        <method name="GetManagedObjects">
+            <arg type="a{oa{sa{sv}}}" direction="out"/>
+        </method>
+    </interface>
+</node>)xml";
+
+    // Only what gBar reads. There is no Menu, so no menu is created.
+    static const char* itemXML = R"xml(
+<node>
+    <interface name="org.kde.StatusNotifierItem">
+        <property name="Id" type="s" access="read"/>
+        <property name="Status" type="s" access="read"/>
+        <property name="IconName" type="s" access="read"/>
+        <property name="IconThemePath" type="s" access="read"/>
+        <property name="IconPixmap" type="a(iiay)" access="read"/>
+        <property name="ToolTip" type="(sa(iiay)ss)" access="read"/>
+        <signal name="NewIcon"/>
+        <signal name="NewToolTip"/>
+    </interface>
+</node>)xml";
+
+    static GDBusNodeInfo* objectManagerInfo = nullptr;
+    static GDBusNodeInfo* itemInfo = nullptr;
+
+    static const char* adapterPath = "/org/bluez/hci0";
+
+    struct Device
+    {
+        std::string path;
+        bool connected = false;
+    };
+    static GDBusConnection* bluezConnection = nullptr;
+    static guint objectManagerID = 0;
+    static std::vector<Device> devices;
+
+    struct Item
+    {
+        // Each item has its own connection, like every application does. gBar tells the items apart by their unique name.
+        GDBusConnection* connection = nullptr;
+        guint objectID = 0;
+        uint32_t frame = 0;
+        // Oldest NewIcon, which gBar hasn't fetched yet
+        int64_t newIconSince = 0;
+    };
+    static std::vector<Item> items;
+    static guint watcherWatchID = 0;
+
+    static GSource* flapSource = nullptr;
+    static GSource* newIconSource = nullptr;
+
+    static GDBusConnection* Connect()
+    {
+        GError* err = nullptr;
+        GDBusConnection* connection = g_dbus_connection_new_for_address_sync(
+            params.address.c_str(), (GDBusConnectionFlags)(G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT | G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+            nullptr, nullptr, &err);
+        if (!connection)
+        {
+            LOG("Mock: Can't connect to " << params.address << ": " << err->message);
+            g_error_free(err);
+        }
+        return connection;
+    }
+
+    // Events, which are due at rate per second since start, minus the ones already sent
+    static uint64_t Due(int64_t start, double rate, uint64_t sent)
+    {
+        uint64_t total = (uint64_t)((g_get_monotonic_time() - start) / 1000000.0 * rate);
+        return total > sent ? total - sent : 0;
+    }
+
+    // Evenly spread, but no busy loop for high rates
+    static GSource* AddTimer(double rate, GSourceFunc fn)
+    {
+        guint intervalMS = (guint)std::clamp(1000.0 / rate, 1.0, 100.0);
+        GSource* source = g_timeout_source_new(intervalMS);
+        g_source_set_callback(source, fn, nullptr, nullptr);
+        g_source_attach(source, context);
+        return source;
+    }
+
+    static void RemoveTimer(GSource*& source)
+    {
+        if (source)
+        {
+            g_source_destroy(source);
+            g_source_unref(source);
+            source = nullptr;
+        }
+    }
+
+    // a{sa{sv}} with a single interface
+    static GVariant* Interfaces(const char* interface, GVariantBuilder* properties)
+    {
+        GVariantBuilder interfaces;
+        g_variant_builder_init(&interfaces, G_VARIANT_TYPE("a{sa{sv}}"));
+        g_variant_builder_add(&interfaces, "{sa{sv}}", interface, properties);
+        return g_variant_builder_end(&interfaces);
+    }
+
+    static void BlueZMethodCall(GDBusConnection*, const char*, const char*, const char*, const char* method, GVariant*,
+                                GDBusMethodInvocation* invocation, void*)
+    {
+        if (strcmp(method, "GetManagedObjects") != 0)
+        {
+            g_dbus_method_invocation_return_dbus_error(invocation, "org.freedesktop.DBus.Error.UnknownMethod", method);
+            return;
+        }
+
+        GVariantBuilder objects;
+        g_variant_builder_init(&objects, G_VARIANT_TYPE("a{oa{sa{sv}}}"));
+
+        GVariantBuilder adapter;
+        g_variant_builder_init(&adapter, G_VARIANT_TYPE("a{sv}"));
+        g_variant_builder_add(&adapter, "{sv}", "Name", g_variant_new_string("mock"));
+        g_variant_builder_add(&adapter, "{sv}", "Powered", g_variant_new_boolean(true));
+        g_variant_builder_add(&objects, "{o@a{sa{sv}}}", adapterPath, Interfaces("org.bluez.Adapter1", &adapter));
+
+        for (size_t i = 0; i < devices.size(); i++)
+        {
+            char mac[18];
+            snprintf(mac, sizeof(mac), "00:00:00:00:%02X:%02X", (unsigned)(i >> 8) & 0xff, (unsigned)i & 0xff);
+            std::string name = "Mock device " + std::to_string(i);
+            GVariantBuilder device;
+            g_variant_builder_init(&device, G_VARIANT_TYPE("a{sv}"));
+            g_variant_builder_add(&device, "{sv}", "Address", g_variant_new_string(mac));
+            g_variant_builder_add(&device, "{sv}", "Name", g_variant_new_string(name.c_str()));
+            g_variant_builder_add(&device, "{sv}", "Icon", g_variant_new_string("audio-headset"));
+            g_variant_builder_add(&device, "{sv}", "Paired", g_variant_new_boolean(true));
+            g_variant_builder_add(&device, "{sv}", "Connected", g_variant_new_boolean(devices[i].connected));
+            g_variant_builder_add(&objects, "{o@a{sa{sv}}}", devices[i].path.c_str(), Interfaces("org.bluez.Device1", &device));
+        }
+        g_dbus_method_invocation_return_value(invocation, g_variant_new("(a{oa{sa{sv}}})", &objects));
+    }
+
+    static gboolean FlapDevices(void*)
+    {
+        static int64_t start = g_get_monotonic_time();
+        static uint64_t sent = 0;
+        static size_t next = 0;
+        for (uint64_t due = Due(start, params.flapHz * devices.size(), sent); due > 0; due--)
+        {
+            Device& device = devices[next++ % devices.size()];
+            device.connected = !device.connected;
+
+            GVariantBuilder changed;
+            g_variant_builder_init(&changed, G_VARIANT_TYPE("a{sv}"));
+            g_variant_builder_add(&changed, "{sv}", "Connected", g_variant_new_boolean(device.connected));
+            g_variant_builder_add(&changed, "{sv}", sentKey, g_variant_new_int64(g_get_monotonic_time()));
+            GVariantBuilder invalidated;
+            g_variant_builder_init(&invalidated, G_VARIANT_TYPE("as"));
+            g_dbus_connection_emit_signal(bluezConnection, nullptr, device.path.c_str(), "org.freedesktop.DBus.Properties", "PropertiesChanged",
+                                          g_variant_new("(sa{sv}as)", "org.bluez.Device1", &changed, &invalidated), nullptr);
+            sent++;
+            stats.flaps++;
+        }
+        return G_SOURCE_CONTINUE;
+    }
+
+    static bool StartBlueZ()
+    {
+        bluezConnection = Connect();
+        if (!bluezConnection)
+        {
+            return false;
+        }
+        for (uint32_t i = 0; i < params.numDevices; i++)
+        {
+            char path[64];
+            snprintf(path, sizeof(path), "%s/dev_00_00_00_00_%02X_%02X", adapterPath, (i >> 8) & 0xff, i & 0xff);
+            devices.push_back({path, i % 2 == 0});
+        }
+
+        static const GDBusInterfaceVTable vtable = {BlueZMethodCall, nullptr, nullptr, {}};
+        GError* err = nullptr;
+        objectManagerID =
+            g_dbus_connection_register_object(bluezConnection, "/", objectManagerInfo->interfaces[0], &vtable, nullptr, nullptr, &err);
+        if (!objectManagerID)
+        {
+            LOG("Mock: Can't export the object manager: " << err->message);
+            g_error_free(err);
+            return false;
+        }
+
+        // Owned before Start returns, gBar checks for BlueZ once on startup
+        GVariant* reply = g_dbus_connection_call_sync(bluezConnection, "org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus",
+                                                      "RequestName", g_variant_new("(su)", "org.bluez", 4 /* DBUS_NAME_FLAG_DO_NOT_QUEUE */),
+                                                      G_VARIANT_TYPE("(u)"), G_DBUS_CALL_FLAGS_NONE, 1000, nullptr, &err);
+        if (!reply)
+        {
+            LOG("Mock: Can't own org.bluez: " << err->message);
+            g_error_free(err);
+            return false;
+        }
+        guint32 result = 0;
+        g_variant_get(reply, "(u)", &result);
+        g_variant_unref(reply);
+        if (result != 1 /* DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER */)
+        {
+            LOG("Mock: org.bluez is already owned");
+            return false;
+        }
+
+        if (params.numDevices && params.flapHz > 0)
+        {
+            flapSource = AddTimer(params.flapHz * params.numDevices, FlapDevices);
+        }
+        return true;
+    }
+
+    // Contents change with every frame, so each NewIcon is a real change
+    static GVariant* Pixmap(size_t index, uint32_t frame)
+    {
+        int32_t size = params.iconSize;
+        std::vector<uint8_t> argb((size_t)size * size * 4);
+        for (size_t i = 0; i < argb.size(); i += 4)
+        {
+            argb[i] = 0xff;
+            argb[i + 1] = (uint8_t)(frame * 37);
+            argb[i + 2] = (uint8_t)(index * 53);
+            argb[i + 3] = (uint8_t)(i / 4);
+        }
+        GVariantBuilder pixmaps;
+        g_variant_builder_init(&pixmaps, G_VARIANT_TYPE("a(iiay)"));
+        g_variant_builder_add(&pixmaps, "(ii@ay)", size, size, g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, argb.data(), argb.size(), 1));
+        return g_variant_builder_end(&pixmaps);
+    }
+
+    // The items have no methods, gBar would only call them on clicks
+    static void ItemMethodCall(GDBusConnection*, const char*, const char*, const char*, const char* method, GVariant*,
+                               GDBusMethodInvocation* invocation, void*)
+    {
+        g_dbus_method_invocation_return_dbus_error(invocation, "org.freedesktop.DBus.Error.UnknownMethod", method);
+    }
+
+    static GVariant* ItemGetProperty(GDBusConnection*, const char*, const char*, const char*, const char* property, GError**, void* data)
+    {
+        size_t index = (size_t)data;
+        Item& item = items[index];
+        if (strcmp(property, "IconPixmap") == 0)
+        {
+            stats.iconFetches++;
+            if (item.newIconSince)
+            {
+                if (item.newIconSince >= measureStart.load())
+                {
+                    stats.fetchLatenciesUs.push_back(g_get_monotonic_time() - item.newIconSince);
+                }
+                item.newIconSince = 0;
+            }
+            return Pixmap(index, item.frame);
+        }
+        if (strcmp(property, "ToolTip") == 0)
+        {
+            std::string title = "Mock item " + std::to_string(index);
+            GVariantBuilder icons;
+            g_variant_builder_init(&icons, G_VARIANT_TYPE("a(iiay)"));
+            return g_variant_new("(sa(iiay)ss)", "", &icons, title.c_str(), "");
+        }
+        if (strcmp(property, "Id") == 0)
+        {
+            return g_variant_new_string(("mock-" + std::to_string(index)).c_str());
+        }
+        if (strcmp(property, "Status") == 0)
+        {
+            return g_variant_new_string("Active");
+        }
+        // IconName and IconThemePath, unused with a pixmap
+        return g_variant_new_string("");
+    }
+
+    static gboolean SendNewIcons(void*)
+    {
+        static int64_t start = g_get_monotonic_time();
+        static uint64_t sent = 0;
+        static size_t next = 0;
+        for (uint64_t due = Due(start, params.newIconHz * items.size(), sent); due > 0; due--)
+        {
+            Item& item = items[next++ % items.size()];
+            item.frame++;
+            if (!item.newIconSince)
+            {
+                item.newIconSince = g_get_monotonic_time();
+            }
+            g_dbus_connection_emit_signal(item.connection, nullptr, "/StatusNotifierItem", "org.kde.StatusNotifierItem", "NewIcon", nullptr, nullptr);
+            sent++;
+            stats.newIcons++;
+        }
+        return G_SOURCE_CONTINUE;
+    }
+
+    static void WatcherAppeared(GDBusConnection*, const char*, const char*, void*)
+    {
+        // Registered by object path, like libappindicator does
+        for (Item& item : items)
+        {
+            g_dbus_connection_call(item.connection, "org.kde.StatusNotifierWatcher", "/StatusNotifierWatcher", "org.kde.StatusNotifierWatcher",
+                                   "RegisterStatusNotifierItem", g_variant_new("(s)", "/StatusNotifierItem"), nullptr, G_DBUS_CALL_FLAGS_NONE, 1000,
+                                   nullptr, nullptr, nullptr);
+        }
+        if (!newIconSource && params.newIconHz > 0)
+        {
+            newIconSource = AddTimer(params.newIconHz * items.size(), SendNewIcons);
+        }
+    }
+
+    static bool StartItems()
+    {
+        static const GDBusInterfaceVTable vtable = {ItemMethodCall, ItemGetProperty, nullptr, {}};
+        for (uint32_t i = 0; i < params.numItems; i++)
+        {
+            Item item;
+            item.connection = Connect();
+            if (!item.connection)
+            {
+                return false;
+            }
+            GError* err = nullptr;
+            item.objectID = g_dbus_connection_register_object(item.connection, "/StatusNotifierItem", itemInfo->interfaces[0], &vtable,
+                                                              (void*)(size_t)i, nullptr, &err);
+            items.push_back(item);
+            if (!item.objectID)
+            {
+                LOG("Mock: Can't export item " << i << ": " << err->message);
+                g_error_free(err);
+                return false;
+            }
+        }
+        if (items.size())
+        {
+            watcherWatchID = g_bus_watch_name_on_connection(items[0].connection, "org.kde.StatusNotifierWatcher", G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                            WatcherAppeared, nullptr, nullptr, nullptr);
+        }
+        return true;
+    }
+
+    static void StopServices()
+    {
+        RemoveTimer(flapSource);
+        RemoveTimer(newIconSource);
+        if (watcherWatchID)
+        {
+            g_bus_unwatch_name(watcherWatchID);
+            watcherWatchID = 0;
+        }
+        for (Item& item : items)
+        {
+            if (item.objectID)
+                g_dbus_connection_unregister_object(item.connection, item.objectID);
+            g_object_unref(item.connection);
+        }
+        items.clear();
+        if (bluezConnection)
+        {
+            if (objectManagerID)
+                g_dbus_connection_unregister_object(bluezConnection, objectManagerID);
+            g_object_unref(bluezConnection);
+            bluezConnection = nullptr;
+            objectManagerID = 0;
+        }
+        devices.clear();
+    }
+
+    static void Run()
+    {
+        // Connections, objects and name watches dispatch on the thread default context at their creation
+        g_main_context_push_thread_default(context);
+        bool started = StartBlueZ() && StartItems();
+        {
+            std::lock_guard lock(readyMutex);
+            ready = started ? 1 : -1;
+        }
+        readyCond.notify_all();
+        if (started)
+        {
+            g_main_loop_run(loop);
+        }
+        StopServices();
+        g_main_context_pop_thread_default(context);
+    }
+
+    bool Start(const Params& startParams)
+    {
+        params = startParams;
+        objectManagerInfo = g_dbus_node_info_new_for_xml(objectManagerXML, nullptr);
+        itemInfo = g_dbus_node_info_new_for_xml(itemXML, nullptr);
+        context = g_main_context_new();
+        loop = g_main_loop_new(context, false);
+        thread = std::thread(Run);
+
+        std::unique_lock lock(readyMutex);
+        readyCond.wait(lock,
+                       []
+                       {
+                           return ready != 0;
+                       });
+        if (ready < 0)
+        {
+            lock.unlock();
+            Stop();
+            return false;
+        }
+        return true;
+    }
+
+    void SetMeasureStart(int64_t start)
+    {
+        measureStart = start;
+    }
+
+    void Stop()
+    {
+        if (!thread.joinable())
+        {
+            return;
+        }
+        g_main_loop_quit(loop);
+        thread.join();
+        g_main_loop_unref(loop);
+        g_main_context_unref(context);
+        g_dbus_node_info_unref(objectManagerInfo);
+        g_dbus_node_info_unref(itemInfo);
+        loop = nullptr;
+        context = nullptr;
+    }
+
+    const Stats& GetStats()
+    {
+        return stats;
+    }
+
+    int64_t GetCPUTimeUs()
+    {
+        clockid_t clock;
+        timespec time{};
+        if (!thread.joinable() || pthread_getcpuclockid(thread.native_handle(), &clock) != 0 || clock_gettime(clock, &time) != 0)
+        {
+            return 0;
+        }
+        return (int64_t)time.tv_sec * 1000000 + time.tv_nsec / 1000;
+    }
+}
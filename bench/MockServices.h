@@ -0,0 +1,50 @@
+#pragma once
+#include <gio/gio.h>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Stand-ins for org.bluez and StatusNotifierItems. They run on their own thread and main context with their own connections,
+// so serving them never blocks gBar's main loop and their cost can be told apart from gBar's.
+namespace MockServices
+{
+    struct Params
+    {
+        // Of the private bus, it serves as system and session bus
+        std::string address;
+
+        uint32_t numDevices = 16;
+        // Connected changes per device and second
+        double flapHz = 1;
+
+        uint32_t numItems = 16;
+        // IconPixmap is iconSize x iconSize
+        int32_t iconSize = 32;
+        // NewIcon signals per item and second
+        double newIconHz = 1;
+    };
+
+    struct Stats
+    {
+        std::atomic<uint64_t> flaps{0};
+        std::atomic<uint64_t> newIcons{0};
+        // Gets of IconPixmap, including the ones of GetAll
+        std::atomic<uint64_t> iconFetches{0};
+        // From a NewIcon to gBar fetching IconPixmap. Coalesced signals count from the first one. Only valid after Stop.
+        std::vector<uint64_t> fetchLatenciesUs;
+    };
+
+    // Blocks until org.bluez is owned on the bus. The items register, once gBar owns org.kde.StatusNotifierWatcher.
+    bool Start(const Params& params);
+    // Latencies of signals sent before measureStart (g_get_monotonic_time) are not recorded
+    void SetMeasureStart(int64_t measureStart);
+    void Stop();
+
+    const Stats& GetStats();
+    // CPU time of the thread of the services
+    int64_t GetCPUTimeUs();
+
+    // Key of the timestamp (g_get_monotonic_time), which is added to every PropertiesChanged of a device. BlueZ ignores unknown keys.
+    constexpr const char* sentKey = "GBarBenchSent";
+}
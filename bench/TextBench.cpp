@@ -0,0 +1,180 @@
+#include "Config.h"
+#include "Widget.h"
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <time.h>
+#include <vector>
+
+// Renders the labels of a vertical bar offscreen, once with CacheVerticalText and once with rotated GtkLabels, and reports the time per frame.
+// Needs a display, e.g. run it with xvfb-run or a headless wayland compositor.
+
+static const char* usage = "Usage: gBarTextBench [--frames=N] [--static=N] [--changing=N]\n";
+
+struct Result
+{
+    double staticFrameUs = 0;
+    double changingFrameUs = 0;
+};
+
+static int64_t ThreadCPUTimeUs()
+{
+    timespec time{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return (int64_t)time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}
+
+static void SetCacheVerticalText(const std::string& configDir, bool cache)
+{
+    std::ofstream(configDir + "/gBar/config") << "CacheVerticalText: " << (cache ? "true" : "false") << "\n";
+    Config::Load();
+}
+
+// Resizes, which the texts queued
+static void ProcessEvents()
+{
+    while (gtk_events_pending())
+    {
+        gtk_main_iteration();
+    }
+}
+
+// Relayouts and draws the whole window, like a frame of the bar
+static void RenderFrame(GtkWidget* window, cairo_surface_t* target)
+{
+    ProcessEvents();
+    cairo_t* cr = cairo_create(target);
+    gtk_widget_draw(window, cr);
+    cairo_destroy(cr);
+}
+
+static Result Run(uint32_t frames, uint32_t numStatic, uint32_t numChanging)
+{
+    // Workspace symbols and the like, which never change, and values of sensors, which change every frame
+    auto box = Widget::Create<Box>();
+    box->SetOrientation(Orientation::Vertical);
+    std::vector<Text*> changing;
+    for (uint32_t i = 0; i < numStatic; i++)
+    {
+        auto text = Widget::Create<Text>();
+        text->SetText(std::to_string(i % 10));
+        text->SetAngle(270);
+        box->AddChild(std::move(text));
+    }
+    for (uint32_t i = 0; i < numChanging; i++)
+    {
+        auto text = Widget::Create<Text>();
+        // Like the sensor texts
+        if (i % 2 == 0)
+        {
+            text->SetStableWidth("100%");
+        }
+        text->SetText("0%");
+        text->SetAngle(270);
+        changing.push_back(text.get());
+        box->AddChild(std::move(text));
+    }
+
+    GtkWidget* window = gtk_offscreen_window_new();
+    Widget::CreateAndAddWidget(box.get(), window);
+    gtk_widget_show_all(window);
+    ProcessEvents();
+    GtkAllocation size;
+    gtk_widget_get_allocation(window, &size);
+    cairo_surface_t* target = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, std::max(size.width, 1), std::max(size.height, 1));
+    // Everything shaped and cached once, like a bar which has been running for a while
+    RenderFrame(window, target);
+
+    Result result;
+    int64_t start = ThreadCPUTimeUs();
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        // E.g. hovering, which redraws without any change
+        RenderFrame(window, target);
+    }
+    result.staticFrameUs = (ThreadCPUTimeUs() - start) / (double)frames;
+
+    start = ThreadCPUTimeUs();
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        for (size_t i = 0; i < changing.size(); i++)
+        {
+            changing[i]->SetText(std::to_string((frame * 7 + i * 13) % 101) + "%");
+        }
+        RenderFrame(window, target);
+    }
+    result.changingFrameUs = (ThreadCPUTimeUs() - start) / (double)frames;
+
+    cairo_surface_destroy(target);
+    box.reset();
+    gtk_widget_destroy(window);
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t frames = 1000;
+    uint32_t numStatic = 10;
+    uint32_t numChanging = 8;
+    for (int i = 1; i < argc; i++)
+    {
+        auto value = [&](const char* name) -> const char*
+        {
+            size_t len = strlen(name);
+            return strncmp(argv[i], name, len) == 0 && argv[i][len] == '=' ? argv[i] + len + 1 : nullptr;
+        };
+        if (const char* v = value("--frames"))
+            frames = std::max(atoi(v), 1);
+        else if (const char* v = value("--static"))
+            numStatic = atoi(v);
+        else if (const char* v = value("--changing"))
+            numChanging = atoi(v);
+        else
+        {
+            fprintf(stderr, "%s", usage);
+            return 1;
+        }
+    }
+
+    if (!gtk_init_check(&argc, &argv))
+    {
+        fprintf(stderr, "No display, skipping\n");
+        // Skipped, for meson
+        return 77;
+    }
+
+    // Config::Load reads the option from $XDG_CONFIG_HOME/gBar/config
+    char* configDir = g_dir_make_tmp("gBarTextBench-XXXXXX", nullptr);
+    if (!configDir)
+    {
+        fprintf(stderr, "Can't create a config directory\n");
+        return 1;
+    }
+    std::string gBarDir = std::string(configDir) + "/gBar";
+    g_mkdir(gBarDir.c_str(), 0755);
+    g_setenv("XDG_CONFIG_HOME", configDir, true);
+
+    // Widgets log their destruction
+    std::cout.setstate(std::ios::badbit);
+    SetCacheVerticalText(configDir, true);
+    Result cached = Run(frames, numStatic, numChanging);
+    SetCacheVerticalText(configDir, false);
+    Result labels = Run(frames, numStatic, numChanging);
+    std::cout.clear();
+
+    printf("%u static and %u changing vertical texts, %u frames, CPU time per frame\n", numStatic, numChanging, frames);
+    printf("  CacheVerticalText: true:  %.1fus redraw, %.1fus with changed texts\n", cached.staticFrameUs, cached.changingFrameUs);
+    printf("  CacheVerticalText: false: %.1fus redraw, %.1fus with changed texts\n", labels.staticFrameUs, labels.changingFrameUs);
+
+    remove((gBarDir + "/config").c_str());
+    g_rmdir(gBarDir.c_str());
+    g_rmdir(configDir);
+    g_free(configDir);
+    return 0;
+}
@@ -1,6 +1,8 @@
 #include "AudioFlyin.h"
 #include "System.h"
 
+#include <cmath>
+
 namespace AudioFlyin
 {
     namespace DynCtx
@@ -13,11 +15,87 @@ namespace AudioFlyin
         double sliderVal;
         bool muted = false;
 
-        int32_t msOpen = 0;
+        // Frame time (in us) of the first frame, -1 if not yet shown
+        int64_t openTime = -1;
         constexpr int32_t closeTime = 2000;
         constexpr int32_t height = 50;
-        int32_t curCloseTime = closeTime;
+        double curCloseTime = closeTime;
         int32_t transitionTime = 50;
+        // How often we check for volume changes
+        constexpr uint32_t pollTime = 100;
+
+        Box* mainBox;
+        guint tickID = 0;
+
+        double MsOpen(int64_t now)
+        {
+            if (openTime < 0)
+            {
+                return 0;
+            }
+            return (double)(now - openTime) / 1000.;
+        }
+
+        int32_t MarginFunction(double x)
+        {
+            // A inverted, cutoff 'V' shape
+            // Fly in -> hover -> fly out
+            double steepness = (double)height / (double)transitionTime;
+            return (int32_t)std::min(-std::abs(x - curCloseTime / 2) * steepness + curCloseTime / 2, (double)height);
+        }
+
+        void StartAnimation();
+
+        int FlyoutTimeout(void*)
+        {
+            // curCloseTime may have been extended since we were scheduled
+            double flyoutBegin = curCloseTime - transitionTime;
+            double remaining = flyoutBegin - MsOpen(g_get_monotonic_time());
+            if (remaining > 0)
+            {
+                g_timeout_add((uint32_t)std::ceil(remaining), FlyoutTimeout, nullptr);
+            }
+            else
+            {
+                StartAnimation();
+            }
+            return false;
+        }
+
+        gboolean Tick(GtkWidget*, GdkFrameClock* clock, void*)
+        {
+            // The frame clock shares its timebase with g_get_monotonic_time()
+            int64_t frameTime = gdk_frame_clock_get_frame_time(clock);
+            if (openTime < 0)
+            {
+                openTime = frameTime;
+            }
+            double msOpen = MsOpen(frameTime);
+
+            win->SetMargin(Anchor::Bottom, MarginFunction(msOpen));
+            if (msOpen >= curCloseTime)
+            {
+                tickID = 0;
+                win->Close();
+                return G_SOURCE_REMOVE;
+            }
+            if (msOpen >= transitionTime && msOpen < curCloseTime - transitionTime)
+            {
+                // Fully flown in. Don't draw any frames, until we need to fly out.
+                tickID = 0;
+                g_timeout_add((uint32_t)std::ceil(curCloseTime - transitionTime - msOpen), FlyoutTimeout, nullptr);
+                return G_SOURCE_REMOVE;
+            }
+            return G_SOURCE_CONTINUE;
+        }
+
+        void StartAnimation()
+        {
+            if (tickID == 0)
+            {
+                tickID = gtk_widget_add_tick_callback(mainBox->Get(), Tick, nullptr, nullptr);
+            }
+        }
 
         void OnChangeVolume(Slider&, double value)
         {
@@ -39,7 +117,7 @@ namespace AudioFlyin
                 if (sliderVal != info.sinkVolume || muted != info.sinkMuted)
                 {
                     // Extend timer
-                    curCloseTime = msOpen + closeTime;
+                    curCloseTime = MsOpen(g_get_monotonic_time()) + closeTime;
 
                     sliderVal = info.sinkVolume;
                     slider->SetValue(info.sinkVolume);
@@ -60,7 +138,7 @@ namespace AudioFlyin
                 if (sliderVal != info.sourceVolume || muted != info.sourceMuted)
                 {
                     // Extend timer
-                    curCloseTime = msOpen + closeTime;
+                    curCloseTime = MsOpen(g_get_monotonic_time()) + closeTime;
 
                     sliderVal = info.sourceVolume;
                     slider->SetValue(info.sourceVolume);
@@ -77,19 +155,6 @@ namespace AudioFlyin
                 }
             }
 
-            msOpen++;
-            auto marginFunction = [](int32_t x) -> int32_t
-            {
-                // A inverted, cutoff 'V' shape
-                // Fly in -> hover -> fly out
-                double steepness = (double)height / (double)transitionTime;
-                return (int32_t)std::min(-std::abs((double)x - (double)curCloseTime / 2) * steepness + (double)curCloseTime / 2, (double)height);
-            };
-            win->SetMargin(Anchor::Bottom, marginFunction(msOpen));
-            if (msOpen >= curCloseTime)
-            {
-                win->Close();
-            }
             return TimerResult::Ok;
         }
     }
@@ -138,8 +203,14 @@ namespace AudioFlyin
         mainWidget->SetSpacing({8, false});
         mainWidget->SetVerticalTransform({16, true, Alignment::Fill});
         mainWidget->SetClass("bar");
-        // We update the margin in the timer, so we need late dispatch.
-        mainWidget->AddTimer<Box>(DynCtx::Main, 1, TimerDispatchBehaviour::LateDispatch);
+        mainWidget->AddTimer<Box>(DynCtx::Main, DynCtx::pollTime, TimerDispatchBehaviour::LateDispatch);
+        // The margin is animated by the frame clock. Only tick while flying in or out.
+        mainWidget->SetOnCreate(
+            [](Widget&)
+            {
+                DynCtx::StartAnimation();
+            });
+        DynCtx::mainBox = mainWidget.get();
 
         auto padding = Widget::Create<Box>();
         padding->SetHorizontalTransform({8, true, Alignment::Fill});
@@ -0,0 +1,219 @@
+#include "AudioMixer.h"
+#include "System.h"
+#include "Common.h"
+
+#include <unordered_map>
+
+namespace AudioMixer
+{
+    namespace DynCtx
+    {
+        struct StreamRow
+        {
+            Box* box = nullptr;
+            Text* name = nullptr;
+            Slider* slider = nullptr;
+            Button* mute = nullptr;
+
+            bool muted = false;
+            uint32_t revision = 0;
+            bool valid = false;
+        };
+
+        // Keyed by the index of the sink input
+        std::unordered_map<uint32_t, StreamRow> rows;
+        // Revision of the stream list, that is currently displayed
+        uint32_t revision = UINT32_MAX;
+        Box* streamListBox;
+        Window* win;
+
+        void UpdateRow(StreamRow& row, const System::AudioStream& stream)
+        {
+            row.name->SetText(stream.appName);
+            row.name->SetTooltip(stream.appName);
+            row.slider->SetValue(stream.volume);
+            row.mute->SetText(stream.muted ? "󰝟" : "󰕾");
+            row.muted = stream.muted;
+            row.revision = stream.revision;
+        }
+
+        StreamRow& CreateRow(uint32_t index)
+        {
+            StreamRow& row = rows[index];
+
+            auto box = Widget::Create<Box>();
+            box->SetClass("mixer-row");
+            box->SetSpacing({8, false});
+            {
+                auto mute = Widget::Create<Button>();
+                mute->SetClass("mixer-mute");
+                mute->OnClick(
+                    [index](Button&)
+                    {
+                        auto it = rows.find(index);
+                        if (it != rows.end())
+                        {
+                            System::SetMutedStream(index, !it->second.muted);
+                        }
+                    });
+                row.mute = mute.get();
+
+                auto name = Widget::Create<Text>();
+                name->SetClass("mixer-name");
+                name->SetHorizontalTransform({150, false, Alignment::Left});
+                row.name = name.get();
+
+                auto slider = Widget::Create<Slider>();
+                slider->SetClass("mixer-volume");
+                slider->SetOrientation(Orientation::Horizontal);
+                slider->SetHorizontalTransform({200, true, Alignment::Fill});
+                slider->SetRange({0, 1, 0.01});
+                slider->OnValueChange(
+                    [index](Slider&, double value)
+                    {
+                        System::SetVolumeStream(index, value);
+                    });
+                row.slider = slider.get();
+
+                box->AddChild(std::move(mute));
+                box->AddChild(std::move(name));
+                box->AddChild(std::move(slider));
+            }
+            row.box = box.get();
+            streamListBox->AddChild(std::move(box));
+            return row;
+        }
+
+        TimerResult OnUpdate(Widget&)
+        {
+            uint32_t newRevision;
+            const std::vector<System::AudioStream>& streams = System::GetAudioStreams(newRevision);
+            if (newRevision == revision)
+            {
+                // Nothing has changed
+                return TimerResult::Ok;
+            }
+            revision = newRevision;
+
+            for (auto& [index, row] : rows)
+            {
+                row.valid = false;
+            }
+
+            // Only touch the rows, that have actually changed. New streams are appended, so the order stays stable.
+            for (auto& stream : streams)
+            {
+                auto it = rows.find(stream.index);
+                if (it == rows.end())
+                {
+                    StreamRow& row = CreateRow(stream.index);
+                    UpdateRow(row, stream);
+                    row.valid = true;
+                }
+                else
+                {
+                    if (it->second.revision != stream.revision)
+                    {
+                        UpdateRow(it->second, stream);
+                    }
+                    it->second.valid = true;
+                }
+            }
+
+            // Remove vanished streams
+            for (auto it = rows.begin(); it != rows.end();)
+            {
+                if (!it->second.valid)
+                {
+                    streamListBox->RemoveChild(it->second.box);
+                    it = rows.erase(it);
+                }
+                else
+                {
+                    it++;
+                }
+            }
+            return TimerResult::Ok;
+        }
+
+        void Close(Button&)
+        {
+            win->Close();
+        }
+    }
+
+    void WidgetHeader(Widget& parentWidget)
+    {
+        auto headerBox = Widget::Create<Box>();
+        headerBox->SetClass("mixer-header-box");
+        {
+            auto headerText = Widget::Create<Text>();
+            headerText->SetText("󰕾 Mixer");
+            headerBox->AddChild(std::move(headerText));
+
+            auto headerClose = Widget::Create<Button>();
+            headerClose->SetText("");
+            headerClose->SetClass("mixer-close");
+            headerClose->SetHorizontalTransform({-1, true, Alignment::Right});
+            headerClose->OnClick(DynCtx::Close);
+            headerBox->AddChild(std::move(headerClose));
+        }
+        parentWidget.AddChild(std::move(headerBox));
+    }
+
+    void WidgetBody(Widget& parentWidget)
+    {
+        auto bodyBox = Widget::Create<Box>();
+        DynCtx::streamListBox = bodyBox.get();
+        bodyBox->SetOrientation(Orientation::Vertical);
+        bodyBox->SetClass("mixer-body-box");
+        // Rows can only be added, once the body is created
+        bodyBox->AddTimer<Widget>(DynCtx::OnUpdate, 100, TimerDispatchBehaviour::LateDispatch);
+        parentWidget.AddChild(std::move(bodyBox));
+    }
+
+    void Create(Window& window, UNUSED int32_t monitor)
+    {
+        DynCtx::win = &window;
+        auto mainWidget = Widget::Create<Box>();
+        mainWidget->SetSpacing({8, false});
+        mainWidget->SetOrientation(Orientation::Vertical);
+        mainWidget->SetVerticalTransform({32, true, Alignment::Fill});
+        mainWidget->SetClass("mixer-bg");
+
+        WidgetHeader(*mainWidget);
+        WidgetBody(*mainWidget);
+
+        window.SetExclusive(false);
+        Anchor anchor;
+        Anchor marginAnchor;
+        switch (Config::Get().location)
+        {
+        case 'T':
+            anchor = Anchor::Right | Anchor::Top;
+            marginAnchor = Anchor::Top;
+            break;
+        case 'B':
+            anchor = Anchor::Bottom | Anchor::Right;
+            marginAnchor = Anchor::Bottom;
+            break;
+        case 'L':
+            anchor = Anchor::Left | Anchor::Bottom;
+            marginAnchor = Anchor::Left;
+            window.SetMargin(Anchor::Bottom, 150);
+            break;
+        case 'R':
+            anchor = Anchor::Right | Anchor::Bottom;
+            marginAnchor = Anchor::Right;
+            window.SetMargin(Anchor::Bottom, 150);
+            break;
+        default:
+            LOG("Invalid location char \"" << Config::Get().location << "\"!");
+            anchor = Anchor::Right | Anchor::Top;
+            marginAnchor = Anchor::Top;
+        }
+        window.SetMargin(marginAnchor, 8);
+        window.SetAnchor(anchor);
+        window.SetMainWidget(std::move(mainWidget));
+    }
+}
@@ -0,0 +1,8 @@
+#pragma once
+#include "Widget.h"
+#include "Window.h"
+
+namespace AudioMixer
+{
+    void Create(Window& window, int32_t monitor);
+}
@@ -4,7 +4,9 @@
 #include "Common.h"
 #include "Config.h"
 #include "SNI.h"
+#include "Image.h"
 #include <cmath>
+#include <list>
 #include <mutex>
 
 namespace Bar
@@ -22,8 +24,65 @@ namespace Bar
             powerBoxRevealer->SetRevealed(hovered);
         }
 
-        static Text* cpuText;
-        static TimerResult UpdateCPU(Sensor& sensor)
+        // Sensors, which are drawn as rings of one SensorCluster, share a single Text. It shows the text of the hovered ring.
+        struct Cluster
+        {
+            SensorCluster* widget = nullptr;
+            Text* text = nullptr;
+            std::vector<std::string> texts;
+            std::vector<std::string> textClasses;
+            size_t shown = 0;
+        };
+        // Stable addresses for the callbacks
+        static std::list<Cluster> clusters;
+
+        static void ShowClusterText(Cluster& cluster, size_t ring)
+        {
+            cluster.shown = ring;
+            cluster.text->SetClass(cluster.textClasses[ring]);
+            cluster.text->SetText(cluster.texts[ring]);
+        }
+
+        // Where an update of a sensor goes to: Either its own Sensor and Text, or a ring of a cluster.
+        struct SensorTarget
+        {
+            Sensor* sensor = nullptr;
+            Text* text = nullptr;
+            Cluster* cluster = nullptr;
+            size_t ring = 0;
+
+            void SetValue(double val) const
+            {
+                if (cluster)
+                    cluster->widget->SetValue(ring, val);
+                else
+                    sensor->SetValue(val);
+            }
+
+            void SetTooltip(const std::string& tooltip) const
+            {
+                if (cluster)
+                    cluster->widget->SetRingTooltip(ring, tooltip);
+                else
+                    sensor->SetTooltip(tooltip);
+            }
+
+            void SetText(const std::string& str) const
+            {
+                if (!cluster)
+                {
+                    text->SetText(str);
+                    return;
+                }
+                cluster->texts[ring] = str;
+                if (cluster->text && cluster->shown == ring)
+                {
+                    cluster->text->SetText(str);
+                }
+            }
+        };
+
+        static TimerResult UpdateCPU(const SensorTarget& target)
         {
             double usage = System::GetCPUUsage();
             double temp = System::GetCPUTemp();
@@ -31,36 +90,78 @@ namespace Bar
             std::string text = "CPU: " + Utils::ToStringPrecision(usage * 100, "%0.1f") + "% " + Utils::ToStringPrecision(temp, "%0.1f") + "°C";
             if (Config::Get().sensorTooltips)
             {
-                sensor.SetTooltip(text);
+                target.SetTooltip(text);
             }
             else
             {
-                cpuText->SetText(text);
+                target.SetText(text);
             }
-            sensor.SetValue(usage);
+            target.SetValue(usage);
             return TimerResult::Ok;
         }
 
-        static Text* batteryText;
-        static TimerResult UpdateBattery(Sensor& sensor)
+        static std::string FormatDuration(int64_t seconds)
         {
-            double percentage = System::GetBatteryPercentage();
+            int64_t hours = seconds / 3600;
+            int64_t minutes = (seconds % 3600) / 60;
+            if (hours)
+            {
+                return std::to_string(hours) + "h " + std::to_string(minutes) + "m";
+            }
+            return std::to_string(minutes) + "m";
+        }
+
+        static uint32_t batteryRevision = UINT32_MAX;
+        static TimerResult UpdateBattery(const SensorTarget& target)
+        {
+            const System::BatteryInfo& info = System::GetBatteryInfo();
+            if (info.revision == batteryRevision)
+            {
+                // Nothing changed
+                return TimerResult::Ok;
+            }
+            batteryRevision = info.revision;
+            // No battery yet, while UPower loads its devices, or only peripherals
+            double percentage = std::max(info.percentage, 0.);
+
+            std::string text = "Battery: " + (info.percentage < 0 ? std::string("-") : Utils::ToStringPrecision(percentage * 100, "%0.1f") + "%");
+            if (info.timeToEmpty > 0)
+            {
+                text += " (" + FormatDuration(info.timeToEmpty) + " left)";
+            }
+            else if (info.timeToFull > 0)
+            {
+                text += " (Full in " + FormatDuration(info.timeToFull) + ")";
+            }
+            std::string peripherals;
+            for (auto& peripheral : info.peripherals)
+            {
+                peripherals += "\n" + peripheral.model + ": " + Utils::ToStringPrecision(peripheral.percentage * 100, "%0.0f") + "%";
+            }
 
-            std::string text = "Battery: " + Utils::ToStringPrecision(percentage * 100, "%0.1f") + "%";
             if (Config::Get().sensorTooltips)
             {
-                sensor.SetTooltip(text);
+                target.SetTooltip(text + peripherals);
             }
             else
             {
-                batteryText->SetText(text);
+                target.SetText(text);
+                if (peripherals.size())
+                {
+                    // Skip first newline
+                    target.SetTooltip(peripherals.substr(1));
+                }
+                else
+                {
+                    // The last peripheral was disconnected
+                    target.SetTooltip("");
+                }
             }
-            sensor.SetValue(percentage);
+            target.SetValue(percentage);
             return TimerResult::Ok;
         }
 
-        static Text* ramText;
-        static TimerResult UpdateRAM(Sensor& sensor)
+        static TimerResult UpdateRAM(const SensorTarget& target)
         {
             System::RAMInfo info = System::GetRAMInfo();
             double used = info.totalGiB - info.freeGiB;
@@ -69,19 +170,18 @@ namespace Bar
             std::string text = "RAM: " + Utils::ToStringPrecision(used, "%0.2f") + "GiB/" + Utils::ToStringPrecision(info.totalGiB, "%0.2f") + "GiB";
             if (Config::Get().sensorTooltips)
             {
-                sensor.SetTooltip(text);
+                target.SetTooltip(text);
             }
             else
             {
-                ramText->SetText(text);
+                target.SetText(text);
             }
-            sensor.SetValue(usedPercent);
+            target.SetValue(usedPercent);
             return TimerResult::Ok;
         }
 
 #if defined WITH_NVIDIA || defined WITH_AMD
-        static Text* gpuText;
-        static TimerResult UpdateGPU(Sensor& sensor)
+        static TimerResult UpdateGPU(const SensorTarget& target)
         {
             System::GPUInfo info = System::GetGPUInfo();
 
@@ -89,18 +189,17 @@ namespace Bar
                                Utils::ToStringPrecision(info.coreTemp, "%0.1f") + "°C";
             if (Config::Get().sensorTooltips)
             {
-                sensor.SetTooltip(text);
+                target.SetTooltip(text);
             }
             else
             {
-                gpuText->SetText(text);
+                target.SetText(text);
             }
-            sensor.SetValue(info.utilisation / 100);
+            target.SetValue(info.utilisation / 100);
             return TimerResult::Ok;
         }
 
-        static Text* vramText;
-        static TimerResult UpdateVRAM(Sensor& sensor)
+        static TimerResult UpdateVRAM(const SensorTarget& target)
         {
             System::VRAMInfo info = System::GetVRAMInfo();
 
@@ -108,19 +207,18 @@ namespace Bar
                                Utils::ToStringPrecision(info.totalGiB, "%0.2f") + "GiB";
             if (Config::Get().sensorTooltips)
             {
-                sensor.SetTooltip(text);
+                target.SetTooltip(text);
             }
             else
             {
-                vramText->SetText(text);
+                target.SetText(text);
             }
-            sensor.SetValue(info.usedGiB / info.totalGiB);
+            target.SetValue(info.usedGiB / info.totalGiB);
             return TimerResult::Ok;
         }
 #endif
 
-        static Text* diskText;
-        static TimerResult UpdateDisk(Sensor& sensor)
+        static TimerResult UpdateDisk(const SensorTarget& target)
         {
             System::DiskInfo info = System::GetDiskInfo();
 
@@ -128,22 +226,30 @@ namespace Bar
                                Utils::ToStringPrecision(info.totalGiB, "%0.2f") + "GiB";
             if (Config::Get().sensorTooltips)
             {
-                sensor.SetTooltip(text);
+                target.SetTooltip(text);
             }
             else
             {
-                diskText->SetText(text);
+                target.SetText(text);
             }
-            sensor.SetValue(info.usedGiB / info.totalGiB);
+            target.SetValue(info.usedGiB / info.totalGiB);
             return TimerResult::Ok;
         }
 
 #ifdef WITH_BLUEZ
         static Button* btIconText;
         static Text* btDevText;
+        static uint32_t btRevision = UINT32_MAX;
         static TimerResult UpdateBluetooth(Box&)
         {
-            System::BluetoothInfo info = System::GetBluetoothInfo();
+            const System::BluetoothInfo& info = System::GetBluetoothInfo();
+            if (info.revision == btRevision)
+            {
+                // Nothing changed
+                return TimerResult::Ok;
+            }
+            btRevision = info.revision;
+
             if (info.defaultController.empty())
             {
                 btIconText->SetClass("bt-label-off");
@@ -167,7 +273,10 @@ namespace Bar
                     if (!dev.connected)
                         continue;
                     std::string ico = System::BTTypeToIcon(dev);
-                    tooltip += dev.name + " & ";
+                    tooltip += dev.name;
+                    if (dev.batteryPercentage >= 0)
+                        tooltip += " (" + std::to_string(dev.batteryPercentage) + "%)";
+                    tooltip += " & ";
                     btDev += ico;
                 }
                 // Delete last delim
@@ -285,9 +394,181 @@ namespace Bar
             return TimerResult::Ok;
         }
 
+        static uint32_t micIndicatorRevision = UINT32_MAX;
+        TimerResult UpdateMicIndicator(Text& text)
+        {
+            uint32_t revision;
+            const std::vector<System::AudioRecorder>& recorders = System::GetAudioRecorders(revision);
+            if (revision == micIndicatorRevision)
+            {
+                // Nothing changed
+                return TimerResult::Ok;
+            }
+            micIndicatorRevision = revision;
+
+            bool anyActive = false;
+            std::string tooltip;
+            for (auto& recorder : recorders)
+            {
+                anyActive |= !recorder.corked;
+                tooltip += recorder.appName;
+                if (recorder.corked)
+                    tooltip += " (Paused)";
+                tooltip += "\n";
+            }
+            // Delete last newline
+            if (tooltip.size())
+                tooltip.pop_back();
+
+            if (recorders.empty())
+            {
+                text.SetVisible(false);
+                text.SetClass("mic-indicator-empty");
+            }
+            else
+            {
+                text.SetVisible(true);
+                text.SetClass(anyActive ? "mic-indicator-active" : "mic-indicator-paused");
+            }
+            text.SetTooltip(tooltip);
+            return TimerResult::Ok;
+        }
+
+        static Box* mediaBox;
+        static Texture* mediaArt;
+        static Text* mediaText;
+        static Button* mediaPlayPause;
+        static uint32_t mediaRevision = UINT32_MAX;
+        static std::string mediaArtUrl;
+        // Album art is decoded once at bar size, so going back to a track doesn't decode it again
+        static Image::SurfaceCache mediaArtCache(8);
+        constexpr int32_t mediaArtSize = 24;
+        constexpr size_t mediaMaxChars = 40;
+
+        static std::string Ellipsize(const std::string& str, size_t maxChars)
+        {
+            if ((size_t)g_utf8_strlen(str.c_str(), -1) <= maxChars)
+            {
+                return str;
+            }
+            const char* end = g_utf8_offset_to_pointer(str.c_str(), maxChars - 1);
+            return std::string(str.c_str(), end) + "…";
+        }
+
+        static void SetMediaArt(const std::string& url)
+        {
+            if (url.empty())
+            {
+                mediaArtUrl.clear();
+                mediaArt->SetSurface(nullptr);
+                mediaArt->SetVisible(false);
+                return;
+            }
+            if (url == mediaArtUrl)
+            {
+                return;
+            }
+            mediaArtUrl = url;
+            cairo_surface_t* surface = mediaArtCache.Get(url);
+            if (surface)
+            {
+                mediaArt->SetSurface(surface);
+                mediaArt->SetVisible(true);
+                return;
+            }
+
+            // Keep showing the old art until the new one is there
+            int32_t size = mediaArtSize * gtk_widget_get_scale_factor(mediaArt->Get());
+            Image::LoadScaledAsync(url, size,
+                                   [url](cairo_surface_t* surface)
+                                   {
+                                       if (!surface)
+                                       {
+                                           return;
+                                       }
+                                       mediaArtCache.Put(url, surface);
+                                       if (url != mediaArtUrl)
+                                       {
+                                           // The track changed while loading, keep it for later and leave the current art alone
+                                           return;
+                                       }
+                                       // Put may have evicted what we're showing, so get the current one again.
+                                       cairo_surface_t* current = mediaArtCache.Get(mediaArtUrl);
+                                       mediaArt->SetSurface(current);
+                                       mediaArt->SetVisible(current != nullptr);
+                                   });
+        }
+
+        static TimerResult UpdateMedia(Box&)
+        {
+            const System::MediaInfo& info = System::GetMediaInfo();
+            if (info.revision == mediaRevision)
+            {
+                // Nothing changed
+                return TimerResult::Ok;
+            }
+            mediaRevision = info.revision;
+
+            if (info.player.empty())
+            {
+                mediaBox->SetVisible(false);
+                return TimerResult::Ok;
+            }
+            mediaBox->SetVisible(true);
+
+            std::string text = info.title;
+            if (info.artist.size())
+            {
+                text += " - " + info.artist;
+            }
+            mediaText->SetText(Ellipsize(text, mediaMaxChars));
+            mediaBox->SetTooltip(info.title + "\n" + info.artist + "\n(" + info.player + ")");
+            mediaPlayPause->SetText(info.playing ? "󰏤" : "󰐊");
+            SetMediaArt(info.artUrl);
+            return TimerResult::Ok;
+        }
+
+        static uint32_t failedUnitsRevision = UINT32_MAX;
+        static TimerResult UpdateFailedUnits(Text& text)
+        {
+            const System::FailedUnitsInfo& info = System::GetFailedUnitsInfo();
+            if (info.revision == failedUnitsRevision)
+            {
+                // Nothing changed
+                return TimerResult::Ok;
+            }
+            failedUnitsRevision = info.revision;
+
+            size_t numFailed = info.systemUnits.size() + info.userUnits.size();
+            if (numFailed == 0)
+            {
+                text.SetVisible(false);
+                text.SetTooltip("");
+                return TimerResult::Ok;
+            }
+            text.SetVisible(true);
+            text.SetText("󰀦 " + std::to_string(numFailed));
+
+            std::string tooltip = "Failed units:";
+            for (auto& unit : info.systemUnits)
+            {
+                tooltip += "\n" + unit;
+            }
+            for (auto& unit : info.userUnits)
+            {
+                tooltip += "\n" + unit + " (user)";
+            }
+            text.SetTooltip(tooltip);
+            return TimerResult::Ok;
+        }
+
         Text* networkText;
         TimerResult UpdateNetwork(NetworkSensor& sensor)
         {
+            if (System::IsSleeping())
+            {
+                return TimerResult::Ok;
+            }
             double bpsUp = System::GetNetworkBpsUpload(updateTime / 1000.0);
             double bpsDown = System::GetNetworkBpsDownload(updateTime / 1000.0);
 
@@ -385,9 +666,99 @@ namespace Bar
         }
     }
 
-    void WidgetSensor(Widget& parent, TimerCallback<Sensor>&& callback, const std::string& sensorClass, const std::string& textClass, Text*& textPtr,
-                      Side side)
+    struct SensorDef
+    {
+        std::function<TimerResult(const DynCtx::SensorTarget&)> update;
+        std::string sensorClass;
+        std::string textClass;
+        // The widest text the sensor usually shows, see Text::SetStableWidth. Empty for texts without a fixed format.
+        std::string textTemplate;
+    };
+
+    // Appends the sensors for widgetName to defs. Returns false, if widgetName is no sensor.
+    bool GetSensorDefs(const std::string& widgetName, std::vector<SensorDef>& defs)
+    {
+        // Cheeky shorthand for all sensors
+        if (widgetName == "Sensors")
+        {
+            for (const char* name : {"Disk", "VRAM", "GPU", "RAM", "CPU", "Battery"})
+            {
+                GetSensorDefs(name, defs);
+            }
+            return true;
+        }
+        if (widgetName == "Disk")
+        {
+            defs.push_back(
+                {DynCtx::UpdateDisk, "disk-util-progress", "disk-data-text", "Disk " + Config::Get().diskPartition + ": 000.00GiB/000.00GiB"});
+            return true;
+        }
+#if defined WITH_NVIDIA || defined WITH_AMD
+        if (widgetName == "VRAM")
+        {
+            if (RuntimeConfig::Get().hasNvidia || RuntimeConfig::Get().hasAMD)
+                defs.push_back({DynCtx::UpdateVRAM, "vram-util-progress", "vram-data-text", "VRAM: 00.00GiB/00.00GiB"});
+            return true;
+        }
+        if (widgetName == "GPU")
+        {
+            if (RuntimeConfig::Get().hasNvidia || RuntimeConfig::Get().hasAMD)
+                defs.push_back({DynCtx::UpdateGPU, "gpu-util-progress", "gpu-data-text", "GPU: 00.0% 00.0°C"});
+            return true;
+        }
+#endif
+        if (widgetName == "RAM")
+        {
+            defs.push_back({DynCtx::UpdateRAM, "ram-util-progress", "ram-data-text", "RAM: 00.00GiB/00.00GiB"});
+            return true;
+        }
+        if (widgetName == "CPU")
+        {
+            defs.push_back({DynCtx::UpdateCPU, "cpu-util-progress", "cpu-data-text", "CPU: 00.0% 00.0°C"});
+            return true;
+        }
+        if (widgetName == "Battery")
+        {
+            // Only show battery percentage if battery folder is set and exists. UPower loads its devices asynchronously, so it is shown as
+            // soon as UPower is available.
+            if (RuntimeConfig::Get().hasUPower || System::GetBatteryPercentage() >= 0)
+                defs.push_back({DynCtx::UpdateBattery, "battery-util-progress", "battery-data-text", ""});
+            return true;
+        }
+        return false;
+    }
+
+    double SensorStartAngle()
     {
+        switch (Config::Get().location)
+        {
+        case 'L':
+        case 'R': return 0;
+        default: return -90;
+        }
+    }
+
+    // The text, which is revealed when hovering a sensor
+    std::unique_ptr<Text> CreateSensorText(const std::string& textClass, const std::string& textTemplate)
+    {
+        auto text = Widget::Create<Text>();
+        text->SetClass(textClass);
+        text->SetAngle(Utils::GetAngle());
+        if (textTemplate.size())
+        {
+            text->SetStableWidth(textTemplate);
+        }
+        // Since we don't know, on which side the text is, add padding to both sides.
+        // This creates double padding on the side opposite to the sensor.
+        // TODO: Remove that padding.
+        Utils::SetTransform(*text, {-1, true, Alignment::Fill, 6, 6});
+        return text;
+    }
+
+    // Wraps sensorWidget in an EventBox, which reveals text (nullptr when using tooltips) on hover
+    void AddSensorWithText(Widget& parent, std::unique_ptr<Widget>&& sensorWidget, std::unique_ptr<Text>&& text, Side side)
+    {
+        bool hasText = text != nullptr;
         auto eventBox = Widget::Create<EventBox>();
         Utils::SetTransform(*eventBox, {-1, false, SideToAlignment(side)});
         {
@@ -396,7 +767,7 @@ namespace Bar
             box->SetOrientation(Utils::GetOrientation());
             {
                 auto revealer = Widget::Create<Revealer>();
-                if (!Config::Get().sensorTooltips)
+                if (hasText)
                 {
                     revealer->SetTransition({Utils::GetTransitionType(SideToDefaultTransition(side)), 500});
                     // Add event to eventbox for the revealer to open
@@ -405,48 +776,24 @@ namespace Bar
                         {
                             textRevealer->SetRevealed(hovered);
                         });
-                    {
-                        auto text = Widget::Create<Text>();
-                        text->SetClass(textClass);
-                        text->SetAngle(Utils::GetAngle());
-                        // Since we don't know, on which side the text is, add padding to both sides.
-                        // This creates double padding on the side opposite to the sensor.
-                        // TODO: Remove that padding.
-                        Utils::SetTransform(*text, {-1, true, Alignment::Fill, 6, 6});
-                        textPtr = text.get();
-                        revealer->AddChild(std::move(text));
-                    }
+                    revealer->AddChild(std::move(text));
                 }
 
-                auto sensor = Widget::Create<Sensor>();
-                sensor->SetClass(sensorClass);
-                double angle = -90;
-                switch (Config::Get().location)
-                {
-                case 'T':
-                case 'B': angle = -90; break;
-                case 'L':
-                case 'R': angle = 0; break;
-                }
-                sensor->SetStyle({angle});
-                sensor->AddTimer<Sensor>(std::move(callback), DynCtx::updateTime);
-                Utils::SetTransform(*sensor, {24, true, Alignment::Fill});
-
                 switch (side)
                 {
                 case Side::Right:
                 case Side::Center:
                 {
-                    if (!Config::Get().sensorTooltips)
+                    if (hasText)
                         box->AddChild(std::move(revealer));
-                    box->AddChild(std::move(sensor));
+                    box->AddChild(std::move(sensorWidget));
                     break;
                 }
                 case Side::Left:
                 {
                     // Invert
-                    box->AddChild(std::move(sensor));
-                    if (!Config::Get().sensorTooltips)
+                    box->AddChild(std::move(sensorWidget));
+                    if (hasText)
                         box->AddChild(std::move(revealer));
                     break;
                 }
@@ -458,6 +805,117 @@ namespace Bar
         parent.AddChild(std::move(eventBox));
     }
 
+    void WidgetSensor(Widget& parent, const SensorDef& def, Side side)
+    {
+        DynCtx::SensorTarget target;
+        std::unique_ptr<Text> text;
+        if (!Config::Get().sensorTooltips)
+        {
+            text = CreateSensorText(def.textClass, def.textTemplate);
+            target.text = text.get();
+        }
+
+        auto sensor = Widget::Create<Sensor>();
+        sensor->SetClass(def.sensorClass);
+        sensor->SetStyle({SensorStartAngle()});
+        target.sensor = sensor.get();
+        sensor->AddTimer<Sensor>(
+            [update = def.update, target](Sensor&)
+            {
+                // Don't sample anything between logind announcing sleep and the resume
+                if (System::IsSleeping())
+                {
+                    return TimerResult::Ok;
+                }
+                return update(target);
+            },
+            DynCtx::updateTime);
+        Utils::SetTransform(*sensor, {24, true, Alignment::Fill});
+
+        AddSensorWithText(parent, std::move(sensor), std::move(text), side);
+    }
+
+    // All sensors as rings of one SensorCluster: One widget, one style context and one timer, instead of an EventBox, Box, Revealer,
+    // Text and Sensor for each of them.
+    void WidgetSensorCluster(Widget& parent, const std::vector<SensorDef>& defs, Side side)
+    {
+        DynCtx::Cluster& cluster = DynCtx::clusters.emplace_back();
+        for (const SensorDef& def : defs)
+        {
+            cluster.texts.push_back("");
+            cluster.textClasses.push_back(def.textClass);
+        }
+
+        std::unique_ptr<Text> text;
+        if (!Config::Get().sensorTooltips)
+        {
+            // Reserve the longest template, so switching between the rings doesn't resize the text
+            std::string textTemplate;
+            for (const SensorDef& def : defs)
+            {
+                if (def.textTemplate.size() > textTemplate.size())
+                    textTemplate = def.textTemplate;
+            }
+            text = CreateSensorText(defs[0].textClass, textTemplate);
+            cluster.text = text.get();
+        }
+
+        auto sensorCluster = Widget::Create<SensorCluster>();
+        sensorCluster->SetClass("sensor-cluster");
+        sensorCluster->SetOrientation(Utils::GetOrientation());
+        sensorCluster->SetRingSize(24);
+        // Same gap as between separate sensors
+        sensorCluster->SetSpacing(6);
+        std::vector<DynCtx::SensorTarget> targets;
+        for (const SensorDef& def : defs)
+        {
+            DynCtx::SensorTarget target;
+            target.cluster = &cluster;
+            target.ring = sensorCluster->AddRing(def.sensorClass, {SensorStartAngle()});
+            targets.push_back(target);
+        }
+        cluster.widget = sensorCluster.get();
+
+        sensorCluster->SetHoverFn(
+            [&cluster](SensorCluster&, int32_t ring)
+            {
+                // Keep the last ring, when leaving into the text
+                if (ring >= 0 && cluster.text)
+                    ShowClusterText(cluster, ring);
+            });
+        sensorCluster->AddTimer<SensorCluster>(
+            [defs, targets](SensorCluster&)
+            {
+                // Don't sample anything between logind announcing sleep and the resume
+                if (System::IsSleeping())
+                {
+                    return TimerResult::Ok;
+                }
+                for (size_t i = 0; i < defs.size(); i++)
+                {
+                    defs[i].update(targets[i]);
+                }
+                return TimerResult::Ok;
+            },
+            DynCtx::updateTime);
+        Utils::SetTransform(*sensorCluster, {-1, true, Alignment::Fill});
+
+        AddSensorWithText(parent, std::move(sensorCluster), std::move(text), side);
+    }
+
+    void WidgetSensorGroup(Widget& parent, const std::vector<SensorDef>& defs, Side side)
+    {
+        if (Config::Get().sensorCluster && defs.size() > 1)
+        {
+            WidgetSensorCluster(parent, defs, side);
+            return;
+        }
+        for (const SensorDef& def : defs)
+        {
+            WidgetSensor(parent, def, side);
+        }
+    }
+
     // Handles in and out
     void WidgetAudio(Widget& parent, Side side)
     {
@@ -614,6 +1072,92 @@ namespace Bar
         parent.AddChild(std::move(text));
     }
 
+    void WidgetMedia(Widget& parent, Side side)
+    {
+        auto box = Widget::Create<Box>();
+        box->SetSpacing({4, false});
+        box->SetOrientation(Utils::GetOrientation());
+        box->SetClass("media-box");
+        Utils::SetTransform(*box, {-1, false, SideToAlignment(side)});
+        DynCtx::mediaBox = box.get();
+        {
+            auto art = Widget::Create<Texture>();
+            art->SetClass("media-art");
+            art->SetAngle(0);
+            Utils::SetTransform(*art, {DynCtx::mediaArtSize, false, Alignment::Fill}, {DynCtx::mediaArtSize, true, Alignment::Fill});
+            DynCtx::mediaArt = art.get();
+
+            auto text = Widget::Create<Text>();
+            text->SetClass("media-text");
+            text->SetAngle(Utils::GetAngle());
+            DynCtx::mediaText = text.get();
+
+            auto previous = Widget::Create<Button>();
+            previous->SetClass("media-button");
+            previous->SetText("󰒮");
+            previous->SetAngle(Utils::GetAngle());
+            previous->OnClick(
+                [](Button&)
+                {
+                    System::MediaPrevious();
+                });
+
+            auto playPause = Widget::Create<Button>();
+            playPause->SetClass("media-button");
+            playPause->SetText("󰐊");
+            playPause->SetAngle(Utils::GetAngle());
+            playPause->OnClick(
+                [](Button&)
+                {
+                    System::MediaPlayPause();
+                });
+            DynCtx::mediaPlayPause = playPause.get();
+
+            auto next = Widget::Create<Button>();
+            next->SetClass("media-button");
+            next->SetText("󰒭");
+            next->SetAngle(Utils::GetAngle());
+            next->OnClick(
+                [](Button&)
+                {
+                    System::MediaNext();
+                });
+
+            box->AddChild(std::move(art));
+            box->AddChild(std::move(text));
+            box->AddChild(std::move(previous));
+            box->AddChild(std::move(playPause));
+            box->AddChild(std::move(next));
+        }
+        // Cheap, since the player state is maintained from signals. Visibility can only be set after the widget has been created
+        box->AddTimer<Box>(DynCtx::UpdateMedia, DynCtx::updateTimeFast, TimerDispatchBehaviour::LateDispatch);
+        parent.AddChild(std::move(box));
+    }
+
+    void WidgetFailedUnits(Widget& parent, Side side)
+    {
+        auto text = Widget::Create<Text>();
+        text->SetText("");
+        text->SetClass("failed-units");
+        text->SetAngle(Utils::GetAngle());
+        Utils::SetTransform(*text, {-1, false, SideToAlignment(side)});
+        // Only looks at the unit list maintained from signals. Visibility can only be set after the widget has been created
+        text->AddTimer<Text>(DynCtx::UpdateFailedUnits, DynCtx::updateTimeFast, TimerDispatchBehaviour::LateDispatch);
+        parent.AddChild(std::move(text));
+    }
+
+    void WidgetMicIndicator(Widget& parent, Side side)
+    {
+        auto text = Widget::Create<Text>();
+        text->SetText("󰍬");
+        text->SetClass("mic-indicator-empty");
+        text->SetAngle(Utils::GetAngle());
+        Utils::SetTransform(*text, {-1, false, SideToAlignment(side)});
+        // Visibility can only be set after the widget has been created
+        text->AddTimer<Text>(DynCtx::UpdateMicIndicator, DynCtx::updateTimeFast, TimerDispatchBehaviour::LateDispatch);
+        parent.AddChild(std::move(text));
+    }
+
 #ifdef WITH_BLUEZ
     void WidgetBluetooth(Widget& parent, Side side)
     {
@@ -653,7 +1197,8 @@ namespace Bar
             }
             }
         }
-        box->AddTimer<Box>(DynCtx::UpdateBluetooth, DynCtx::updateTime);
+        // Cheap, since the bluetooth state is maintained from signals
+        box->AddTimer<Box>(DynCtx::UpdateBluetooth, DynCtx::updateTimeFast);
 
         parent.AddChild(std::move(box));
     }
@@ -682,6 +1227,7 @@ namespace Bar
                         auto text = Widget::Create<Text>();
                         text->SetClass("network-data-text");
                         text->SetAngle(Utils::GetAngle());
+                        text->SetStableWidth(Config::Get().networkAdapter + ": 000.0MiB Up/000.0MiB Down");
                         // Margins have the same problem as the WidgetSensor ones...
                         Utils::SetTransform(*text, {-1, true, Alignment::Fill, 6, 6});
                         DynCtx::networkText = text.get();
@@ -722,25 +1268,6 @@ namespace Bar
         parent.AddChild(std::move(eventBox));
     }
 
-    void WidgetSensors(Widget& parent, Side side)
-    {
-        WidgetSensor(parent, DynCtx::UpdateDisk, "disk-util-progress", "disk-data-text", DynCtx::diskText, side);
-#if defined WITH_NVIDIA || defined WITH_AMD
-        if (RuntimeConfig::Get().hasNvidia || RuntimeConfig::Get().hasAMD)
-        {
-            WidgetSensor(parent, DynCtx::UpdateVRAM, "vram-util-progress", "vram-data-text", DynCtx::vramText, side);
-            WidgetSensor(parent, DynCtx::UpdateGPU, "gpu-util-progress", "gpu-data-text", DynCtx::gpuText, side);
-        }
-#endif
-        WidgetSensor(parent, DynCtx::UpdateRAM, "ram-util-progress", "ram-data-text", DynCtx::ramText, side);
-        WidgetSensor(parent, DynCtx::UpdateCPU, "cpu-util-progress", "cpu-data-text", DynCtx::cpuText, side);
-        // Only show battery percentage if battery folder is set and exists
-        if (System::GetBatteryPercentage() >= 0)
-        {
-            WidgetSensor(parent, DynCtx::UpdateBattery, "battery-util-progress", "battery-data-text", DynCtx::batteryText, side);
-        }
-    }
-
     void WidgetPower(Widget& parent, Side side)
     {
         // TODO: Abstract this (Currently not DRY)
@@ -992,62 +1519,33 @@ namespace Bar
             WidgetAudio(parent, side);
             return;
         }
-        if (widgetName == "Bluetooth")
+        if (widgetName == "Media")
         {
-#ifdef WITH_BLUEZ
-            if (RuntimeConfig::Get().hasBlueZ)
-                WidgetBluetooth(parent, side);
-#endif
+            WidgetMedia(parent, side);
             return;
         }
-        if (widgetName == "Network")
+        if (widgetName == "FailedUnits")
         {
-            if (Config::Get().networkWidget && RuntimeConfig::Get().hasNet)
-                WidgetNetwork(parent, side);
+            WidgetFailedUnits(parent, side);
             return;
         }
-        // Cheeky shorthand for all sensors
-        if (widgetName == "Sensors")
+        if (widgetName == "MicIndicator")
         {
-            WidgetSensors(parent, side);
+            WidgetMicIndicator(parent, side);
             return;
         }
-        if (widgetName == "Disk")
-        {
-            WidgetSensor(parent, DynCtx::UpdateDisk, "disk-util-progress", "disk-data-text", DynCtx::diskText, side);
-            return;
-        }
-        if (widgetName == "VRAM")
-        {
-#if defined WITH_NVIDIA || defined WITH_AMD
-            if (RuntimeConfig::Get().hasNvidia || RuntimeConfig::Get().hasAMD)
-                WidgetSensor(parent, DynCtx::UpdateVRAM, "vram-util-progress", "vram-data-text", DynCtx::vramText, side);
-            return;
-#endif
-        }
-        if (widgetName == "GPU")
+        if (widgetName == "Bluetooth")
         {
-#if defined WITH_NVIDIA || defined WITH_AMD
-            if (RuntimeConfig::Get().hasNvidia || RuntimeConfig::Get().hasAMD)
-                WidgetSensor(parent, DynCtx::UpdateGPU, "gpu-util-progress", "gpu-data-text", DynCtx::gpuText, side);
-            return;
+#ifdef WITH_BLUEZ
+            if (RuntimeConfig::Get().hasBlueZ)
+                WidgetBluetooth(parent, side);
 #endif
-        }
-        if (widgetName == "RAM")
-        {
-            WidgetSensor(parent, DynCtx::UpdateRAM, "ram-util-progress", "ram-data-text", DynCtx::ramText, side);
             return;
         }
-        if (widgetName == "CPU")
-        {
-            WidgetSensor(parent, DynCtx::UpdateCPU, "cpu-util-progress", "cpu-data-text", DynCtx::cpuText, side);
-            return;
-        }
-        if (widgetName == "Battery")
+        if (widgetName == "Network")
         {
-            // Only show battery percentage if battery folder is set and exists
-            if (System::GetBatteryPercentage() >= 0)
-                WidgetSensor(parent, DynCtx::UpdateBattery, "battery-util-progress", "battery-data-text", DynCtx::batteryText, side);
+            if (Config::Get().networkWidget && RuntimeConfig::Get().hasNet)
+                WidgetNetwork(parent, side);
             return;
         }
         if (widgetName == "Power")
@@ -1056,8 +1554,25 @@ namespace Bar
             return;
         }
         LOG("Warning: Unkwown widget name " << widgetName << "!"
-                                            << "\n\tKnown names are: Workspaces, Time, Tray, Packages, Sound, Bluetooth, Network, Sensors, Disk, "
-                                               "VRAM, GPU, RAM, CPU, Battery, Power");
+                                            << "\n\tKnown names are: Workspaces, Time, Tray, Packages, Sound, Media, FailedUnits, MicIndicator, Bluetooth, Network, "
+                                               "Sensors, Disk, VRAM, GPU, RAM, CPU, Battery, Power");
+    }
+
+    // Consecutive sensors are grouped, so they can be drawn as one SensorCluster
+    void AddWidgets(const std::vector<std::string>& widgetNames, Widget& parent, Side side)
+    {
+        std::vector<SensorDef> sensors;
+        for (auto& widgetName : widgetNames)
+        {
+            if (GetSensorDefs(widgetName, sensors))
+            {
+                continue;
+            }
+            WidgetSensorGroup(parent, sensors, side);
+            sensors.clear();
+            ChooseWidgetToDraw(widgetName, parent, side);
+        }
+        WidgetSensorGroup(parent, sensors, side);
     }
 
     void Create(Window& window, int32_t monitor)
@@ -1089,20 +1604,14 @@ namespace Bar
             // For not centerTime we want to set it as much right as possible. So let this expand as much as possible.
             Utils::SetTransform(*left, {endLeftWidgets, !Config::Get().centerTime, Alignment::Left, 12, 0});
 
-            for (auto& widget : Config::Get().widgetsLeft)
-            {
-                ChooseWidgetToDraw(widget, *left, Side::Left);
-            }
+            AddWidgets(Config::Get().widgetsLeft, *left, Side::Left);
 
             auto center = Widget::Create<Box>();
             center->SetOrientation(Utils::GetOrientation());
             Utils::SetTransform(*center, {(int)Config::Get().timeSpace, false, Alignment::Left});
             center->SetSpacing({6, false});
 
-            for (auto& widget : Config::Get().widgetsCenter)
-            {
-                ChooseWidgetToDraw(widget, *center, Side::Center);
-            }
+            AddWidgets(Config::Get().widgetsCenter, *center, Side::Center);
 
             auto right = Widget::Create<Box>();
             right->SetClass("right");
@@ -1110,10 +1619,7 @@ namespace Bar
             right->SetOrientation(Utils::GetOrientation());
             Utils::SetTransform(*right, {-1, true, Alignment::Right, 0, 10});
 
-            for (auto& widget : Config::Get().widgetsRight)
-            {
-                ChooseWidgetToDraw(widget, *right, Side::Right);
-            }
+            AddWidgets(Config::Get().widgetsRight, *right, Side::Right);
 
             mainWidget->AddChild(std::move(left));
             mainWidget->AddChild(std::move(center));
@@ -0,0 +1,434 @@
+#pragma once
+#include "System.h"
+#include "Common.h"
+#include "Config.h"
+#include "DBus.h"
+
+#include <gio/gio.h>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <vector>
+
+#ifdef WITH_BLUEZ
+// Mirror of the BlueZ object tree. It is loaded once and then only maintained from the InterfacesAdded, InterfacesRemoved and
+// PropertiesChanged signals of org.bluez, so reading it never causes any d-bus traffic.
+namespace BlueZ
+{
+    struct Adapter
+    {
+        std::string name;
+        bool powered = false;
+    };
+
+    static bool initialized = false;
+
+    // Keyed by object path
+    static std::map<std::string, Adapter> adapters;
+    static std::map<std::string, System::BluetoothDevice> devices;
+
+    static System::BluetoothInfo info;
+    static bool dirty = true;
+
+    static DBus::SubscriptionID interfacesAddedID = 0;
+    static DBus::SubscriptionID interfacesRemovedID = 0;
+    static DBus::SubscriptionID propertiesChangedID = 0;
+    static guint nameWatcherID = 0;
+    static bool vanished = false;
+
+    // Adapters we've started a discovery session on
+    static std::vector<std::string> discoveringAdapters;
+
+    inline void ApplyAdapterProperties(Adapter& adapter, GVariantIter* properties)
+    {
+        const char* key = nullptr;
+        GVariant* value = nullptr;
+        while (g_variant_iter_next(properties, "{&sv}", &key, &value))
+        {
+            if (strcmp(key, "Name") == 0)
+            {
+                adapter.name = g_variant_get_string(value, nullptr);
+            }
+            else if (strcmp(key, "Powered") == 0)
+            {
+                adapter.powered = g_variant_get_boolean(value);
+            }
+            g_variant_unref(value);
+        }
+    }
+
+    inline void ApplyDeviceProperties(System::BluetoothDevice& device, GVariantIter* properties)
+    {
+        const char* key = nullptr;
+        GVariant* value = nullptr;
+        while (g_variant_iter_next(properties, "{&sv}", &key, &value))
+        {
+            if (strcmp(key, "Address") == 0)
+            {
+                device.mac = g_variant_get_string(value, nullptr);
+            }
+            else if (strcmp(key, "Name") == 0)
+            {
+                device.name = g_variant_get_string(value, nullptr);
+            }
+            else if (strcmp(key, "Icon") == 0)
+            {
+                device.type = g_variant_get_string(value, nullptr);
+            }
+            else if (strcmp(key, "Connected") == 0)
+            {
+                device.connected = g_variant_get_boolean(value);
+            }
+            else if (strcmp(key, "Paired") == 0)
+            {
+                device.paired = g_variant_get_boolean(value);
+            }
+            g_variant_unref(value);
+        }
+    }
+
+    inline void ApplyBatteryProperties(System::BluetoothDevice& device, GVariantIter* properties)
+    {
+        const char* key = nullptr;
+        GVariant* value = nullptr;
+        while (g_variant_iter_next(properties, "{&sv}", &key, &value))
+        {
+            if (strcmp(key, "Percentage") == 0)
+            {
+                device.batteryPercentage = g_variant_get_byte(value);
+            }
+            g_variant_unref(value);
+        }
+    }
+
+    // interfaces is of type a{sa{sv}}
+    inline void AddInterfaces(const char* path, GVariantIter* interfaces)
+    {
+        const char* interface = nullptr;
+        GVariantIter* properties = nullptr;
+        while (g_variant_iter_next(interfaces, "{&sa{sv}}", &interface, &properties))
+        {
+            if (strcmp(interface, "org.bluez.Adapter1") == 0)
+            {
+                ApplyAdapterProperties(adapters[path], properties);
+                dirty = true;
+            }
+            else if (strcmp(interface, "org.bluez.Device1") == 0)
+            {
+                System::BluetoothDevice& device = devices[path];
+                device.path = path;
+                ApplyDeviceProperties(device, properties);
+                dirty = true;
+            }
+            else if (strcmp(interface, "org.bluez.Battery1") == 0)
+            {
+                // Lives on the device object, but is only exported while the device is connected
+                System::BluetoothDevice& device = devices[path];
+                device.path = path;
+                ApplyBatteryProperties(device, properties);
+                dirty = true;
+            }
+            g_variant_iter_free(properties);
+        }
+    }
+
+    // objects is of type (a{oa{sa{sv}}})
+    inline void LoadManagedObjects(GVariant* objects)
+    {
+        adapters.clear();
+        devices.clear();
+
+        GVariantIter* topArray = nullptr;
+        g_variant_get(objects, "(a{oa{sa{sv}}})", &topArray);
+
+        const char* path = nullptr;
+        GVariantIter* interfaces = nullptr;
+        while (g_variant_iter_next(topArray, "{&oa{sa{sv}}}", &path, &interfaces))
+        {
+            AddInterfaces(path, interfaces);
+            g_variant_iter_free(interfaces);
+        }
+        g_variant_iter_free(topArray);
+        dirty = true;
+    }
+
+    inline void InterfacesAdded(const char*, const char*, const char*, const char*, GVariant* params)
+    {
+        const char* path = nullptr;
+        GVariantIter* interfaces = nullptr;
+        g_variant_get(params, "(&oa{sa{sv}})", &path, &interfaces);
+        AddInterfaces(path, interfaces);
+        g_variant_iter_free(interfaces);
+    }
+
+    inline void InterfacesRemoved(const char*, const char*, const char*, const char*, GVariant* params)
+    {
+        const char* path = nullptr;
+        GVariantIter* interfaces = nullptr;
+        g_variant_get(params, "(&oas)", &path, &interfaces);
+
+        const char* interface = nullptr;
+        while (g_variant_iter_next(interfaces, "&s", &interface))
+        {
+            if (strcmp(interface, "org.bluez.Adapter1") == 0)
+            {
+                adapters.erase(path);
+                dirty = true;
+            }
+            else if (strcmp(interface, "org.bluez.Device1") == 0)
+            {
+                devices.erase(path);
+                dirty = true;
+            }
+            else if (strcmp(interface, "org.bluez.Battery1") == 0)
+            {
+                auto it = devices.find(path);
+                if (it != devices.end())
+                {
+                    it->second.batteryPercentage = -1;
+                    dirty = true;
+                }
+            }
+        }
+        g_variant_iter_free(interfaces);
+    }
+
+    inline void PropertiesChanged(const char*, const char* path, const char*, const char*, GVariant* params)
+    {
+        const char* interface = nullptr;
+        GVariantIter* properties = nullptr;
+        g_variant_get(params, "(&sa{sv}as)", &interface, &properties, nullptr);
+
+        if (strcmp(interface, "org.bluez.Adapter1") == 0)
+        {
+            auto it = adapters.find(path);
+            if (it != adapters.end())
+            {
+                ApplyAdapterProperties(it->second, properties);
+                dirty = true;
+            }
+        }
+        else if (strcmp(interface, "org.bluez.Device1") == 0)
+        {
+            auto it = devices.find(path);
+            if (it != devices.end())
+            {
+                ApplyDeviceProperties(it->second, properties);
+                dirty = true;
+            }
+        }
+        else if (strcmp(interface, "org.bluez.Battery1") == 0)
+        {
+            auto it = devices.find(path);
+            if (it != devices.end())
+            {
+                ApplyBatteryProperties(it->second, properties);
+                dirty = true;
+            }
+        }
+        g_variant_iter_free(properties);
+    }
+
+    inline void Init()
+    {
+        // Try connecting to d-bus and org.bluez
+        GDBusConnection* connection = DBus::Get(DBus::Bus::System);
+        if (!connection)
+        {
+            LOG("Can't connect to d-bus! Disabling Bluetooth!");
+            // dbus not found, disable bluetooth
+            RuntimeConfig::Get().hasBlueZ = false;
+            return;
+        }
+
+        // Subscribe before the initial load, so we don't miss anything in between
+        interfacesAddedID =
+            DBus::Subscribe(DBus::Bus::System, "org.bluez", "org.freedesktop.DBus.ObjectManager", "InterfacesAdded", nullptr, InterfacesAdded);
+        interfacesRemovedID =
+            DBus::Subscribe(DBus::Bus::System, "org.bluez", "org.freedesktop.DBus.ObjectManager", "InterfacesRemoved", nullptr, InterfacesRemoved);
+        propertiesChangedID =
+            DBus::Subscribe(DBus::Bus::System, "org.bluez", "org.freedesktop.DBus.Properties", "PropertiesChanged", nullptr, PropertiesChanged);
+
+        // Blocking, since we need to know whether BlueZ is there before building the bar
+        GError* err = nullptr;
+        GVariant* objects = g_dbus_connection_call_sync(connection, "org.bluez", "/", "org.freedesktop.DBus.ObjectManager", "GetManagedObjects",
+                                                        nullptr, G_VARIANT_TYPE("(a{oa{sa{sv}}})"), G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &err);
+        if (!objects)
+        {
+            LOG("Can't connect to BlueZ d-bus! Disabling Bluetooth!");
+            LOG(err->message);
+            g_error_free(err);
+            // Not found, disable bluetooth
+            RuntimeConfig::Get().hasBlueZ = false;
+            return;
+        }
+        LoadManagedObjects(objects);
+        g_variant_unref(objects);
+        initialized = true;
+
+        // bluetoothd can be restarted, in which case we need to load everything again.
+        auto appeared = [](GDBusConnection*, const char*, const char*, void*)
+        {
+            if (!vanished)
+            {
+                return;
+            }
+            vanished = false;
+            LOG("BlueZ: org.bluez reappeared, reloading objects");
+            DBus::Call(DBus::Bus::System, "org.bluez", "/", "org.freedesktop.DBus.ObjectManager", "GetManagedObjects", nullptr,
+                       G_VARIANT_TYPE("(a{oa{sa{sv}}})"),
+                       [](GVariant* objects)
+                       {
+                           if (objects)
+                           {
+                               LoadManagedObjects(objects);
+                           }
+                       });
+        };
+        auto lost = [](GDBusConnection*, const char*, void*)
+        {
+            LOG("BlueZ: org.bluez vanished");
+            vanished = true;
+            adapters.clear();
+            devices.clear();
+            // The discovery sessions died with bluetoothd
+            discoveringAdapters.clear();
+            dirty = true;
+        };
+        nameWatcherID =
+            g_bus_watch_name_on_connection(connection, "org.bluez", G_BUS_NAME_WATCHER_FLAGS_NONE, +appeared, +lost, nullptr, nullptr);
+    }
+
+    inline const System::BluetoothInfo& GetInfo()
+    {
+        if (!dirty)
+        {
+            return info;
+        }
+        dirty = false;
+
+        info.defaultController.clear();
+        for (auto& [path, adapter] : adapters)
+        {
+            if (adapter.powered)
+            {
+                info.defaultController = adapter.name;
+            }
+        }
+        info.devices.clear();
+        for (auto& [path, device] : devices)
+        {
+            info.devices.push_back(device);
+        }
+        info.revision++;
+        return info;
+    }
+
+    // Connects a device, pairing it first if needed. onFinish is called on the main context.
+    inline void ConnectDevice(const System::BluetoothDevice& device, std::function<void(bool, const System::BluetoothDevice&)>&& onFinish)
+    {
+        auto connect = [](const System::BluetoothDevice& device, std::function<void(bool, const System::BluetoothDevice&)> onFinish)
+        {
+            if (device.connected)
+            {
+                onFinish(true, device);
+                return;
+            }
+            DBus::CallVoid(DBus::Bus::System, "org.bluez", device.path.c_str(), "org.bluez.Device1", "Connect", nullptr,
+                           [device, onFinish = std::move(onFinish)](bool success)
+                           {
+                               onFinish(success, device);
+                           });
+        };
+
+        // 1. Pair
+        if (!device.paired)
+        {
+            DBus::CallVoid(DBus::Bus::System, "org.bluez", device.path.c_str(), "org.bluez.Device1", "Pair", nullptr,
+                           [device, onFinish = std::move(onFinish), connect](bool success)
+                           {
+                               if (!success)
+                               {
+                                   onFinish(false, device);
+                                   return;
+                               }
+                               // 2. Connect
+                               connect(device, onFinish);
+                           });
+            return;
+        }
+        // 2. Connect
+        connect(device, std::move(onFinish));
+    }
+
+    inline void DisconnectDevice(const System::BluetoothDevice& device, std::function<void(bool, const System::BluetoothDevice&)>&& onFinish)
+    {
+        if (!device.connected)
+        {
+            onFinish(true, device);
+            return;
+        }
+        DBus::CallVoid(DBus::Bus::System, "org.bluez", device.path.c_str(), "org.bluez.Device1", "Disconnect", nullptr,
+                       [device, onFinish = std::move(onFinish)](bool success)
+                       {
+                           onFinish(success, device);
+                       });
+    }
+
+    inline void CallAdapter(const std::string& path, const char* method, GVariant* params)
+    {
+        DBus::CallVoid(DBus::Bus::System, "org.bluez", path.c_str(), "org.bluez.Adapter1", method, params);
+    }
+
+    inline void StopDiscovery()
+    {
+        if (!initialized)
+        {
+            return;
+        }
+        for (auto& path : discoveringAdapters)
+        {
+            CallAdapter(path, "StopDiscovery", nullptr);
+        }
+        discoveringAdapters.clear();
+    }
+
+    // Found devices are reported through InterfacesAdded, so they end up in the device table like every other device.
+    // BlueZ ties the discovery session to our bus connection, so it is stopped for us should we exit without calling StopDiscovery.
+    inline void StartDiscovery()
+    {
+        if (!initialized)
+        {
+            return;
+        }
+        StopDiscovery();
+        for (auto& [path, adapter] : adapters)
+        {
+            if (!adapter.powered)
+            {
+                continue;
+            }
+            // Don't report every advertisement of a device again, we only care about new devices.
+            GVariantBuilder filter;
+            g_variant_builder_init(&filter, G_VARIANT_TYPE("a{sv}"));
+            g_variant_builder_add(&filter, "{sv}", "Transport", g_variant_new_string("auto"));
+            g_variant_builder_add(&filter, "{sv}", "DuplicateData", g_variant_new_boolean(false));
+
+            // Calls on the same connection are delivered in order, so the filter is set before discovery starts.
+            CallAdapter(path, "SetDiscoveryFilter", g_variant_new("(a{sv})", &filter));
+            CallAdapter(path, "StartDiscovery", nullptr);
+            discoveringAdapters.push_back(path);
+        }
+    }
+
+    inline void Shutdown()
+    {
+        if (nameWatcherID)
+            g_bus_unwatch_name(nameWatcherID);
+        DBus::Unsubscribe(interfacesAddedID);
+        DBus::Unsubscribe(interfacesRemovedID);
+        DBus::Unsubscribe(propertiesChangedID);
+        initialized = false;
+    }
+}
+#endif
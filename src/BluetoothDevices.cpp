@@ -1,6 +1,5 @@
 #include "BluetoothDevices.h"
 #include "System.h"
-#include <mutex>
 #include <unordered_map>
 #include <string>
 #include <algorithm>
@@ -27,12 +26,35 @@ namespace BluetoothDevices
             DeviceState state{};
         };
 
-        std::mutex deviceMutex;
         std::vector<BTDeviceWithState> devices;
         Box* deviceListBox;
         Window* win;
         bool scanning = false;
 
+        void InvalidateDeviceUI();
+
+        // Called on the main thread. The device list may have changed while BlueZ was busy, so look the device up again.
+        void OnRequestFinished(bool success, const System::BluetoothDevice& device, DeviceState request)
+        {
+            if (success)
+            {
+                // The state is cleared, once BlueZ reports the new connection state
+                return;
+            }
+            auto it = std::find_if(devices.begin(), devices.end(),
+                                   [&](auto& x)
+                                   {
+                                       return x.device.mac == device.mac;
+                                   });
+            if (it == devices.end())
+            {
+                return;
+            }
+            it->state &= ~request;
+            it->state |= DeviceState::Failed;
+            InvalidateDeviceUI();
+        }
+
         void OnClick(Button& button, BTDeviceWithState& device)
         {
             DeviceState& state = device.state;
@@ -49,16 +71,9 @@ namespace BluetoothDevices
                 state |= DeviceState::RequestConnect;
 
                 System::ConnectBTDevice(device.device,
-                                        [&dev = device, &but = button](bool success, System::BluetoothDevice&)
+                                        [](bool success, const System::BluetoothDevice& device)
                                         {
-                                            deviceMutex.lock();
-                                            if (!success)
-                                            {
-                                                dev.state &= ~DeviceState::RequestConnect;
-                                                dev.state |= DeviceState::Failed;
-                                                but.AddClass("failed");
-                                            }
-                                            deviceMutex.unlock();
+                                            OnRequestFinished(success, device, DeviceState::RequestConnect);
                                         });
             }
             else if (FLAG_CHECK(state, DeviceState::Connected) && !FLAG_CHECK(state, DeviceState::RequestDisconnect))
@@ -68,30 +83,29 @@ namespace BluetoothDevices
                 state |= DeviceState::RequestDisconnect;
 
                 System::DisconnectBTDevice(device.device,
-                                           [&dev = device, &but = button](bool success, System::BluetoothDevice&)
+                                           [](bool success, const System::BluetoothDevice& device)
                                            {
-                                               deviceMutex.lock();
-                                               if (!success)
-                                               {
-                                                   dev.state &= ~DeviceState::RequestDisconnect;
-                                                   dev.state |= DeviceState::Failed;
-                                                   but.AddClass("failed");
-                                               }
-                                               deviceMutex.unlock();
+                                               OnRequestFinished(success, device, DeviceState::RequestDisconnect);
                                            });
             }
         }
 
         void UpdateDeviceUIElem(Button& button, BTDeviceWithState& device)
         {
+            std::string text;
             if (device.device.name.size())
             {
-                button.SetText(System::BTTypeToIcon(device.device) + device.device.name);
+                text = System::BTTypeToIcon(device.device) + device.device.name;
             }
             else
             {
-                button.SetText(device.device.mac);
+                text = device.device.mac;
+            }
+            if (device.device.batteryPercentage >= 0)
+            {
+                text += " (" + std::to_string(device.device.batteryPercentage) + "%)";
             }
+            button.SetText(text);
             bool requestConnect = FLAG_CHECK(device.state, DeviceState::RequestConnect);
             bool requestDisconnect = FLAG_CHECK(device.state, DeviceState::RequestDisconnect);
             if (requestConnect || (!requestDisconnect && FLAG_CHECK(device.state, DeviceState::Connected)))
@@ -149,15 +163,24 @@ namespace BluetoothDevices
             }
         }
 
+        uint32_t revision = UINT32_MAX;
         TimerResult OnUpdate(Widget&)
         {
+            const System::BluetoothInfo& info = System::GetBluetoothInfo();
+            if (info.revision == revision)
+            {
+                // Nothing changed
+                return TimerResult::Ok;
+            }
+            revision = info.revision;
+
             // Invalidate each current device
             for (auto& device : devices)
             {
                 device.state |= DeviceState::Invalid;
             }
 
-            for (auto& device : System::GetBluetoothInfo().devices)
+            for (auto& device : info.devices)
             {
                 auto stateDevIt = std::find_if(devices.begin(), devices.end(),
                                                [&](auto& x)
@@ -246,6 +246,9 @@ void Config::Load()
         AddConfigVar("UseHyprlandIPC", config.useHyprlandIPC, lineView, foundProperty);
         AddConfigVar("EnableSNI", config.enableSNI, lineView, foundProperty);
         AddConfigVar("SensorTooltips", config.sensorTooltips, lineView, foundProperty);
+        AddConfigVar("UseUPower", config.useUPower, lineView, foundProperty);
+        AddConfigVar("CacheVerticalText", config.cacheVerticalText, lineView, foundProperty);
+        AddConfigVar("SensorCluster", config.sensorCluster, lineView, foundProperty);
 
         AddConfigVar("MinUploadBytes", config.minUploadBytes, lineView, foundProperty);
         AddConfigVar("MaxUploadBytes", config.maxUploadBytes, lineView, foundProperty);
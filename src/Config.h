@@ -14,7 +14,7 @@ public:
 
     std::string cpuThermalZone = "";     // idk, no standard way of doing this.
     std::string networkAdapter = "eno1"; // Is this standard?
-    std::string suspendCommand = "systemctl suspend";
+    std::string suspendCommand = ""; // Empty: Suspend through logind
     std::string lockCommand = "";   // idk, no standard way of doing this.
     std::string exitCommand = "";   // idk, no standard way of doing this.
     std::string batteryFolder = ""; // this can be BAT0, BAT1, etc. Usually in /sys/class/power_supply
@@ -39,6 +39,9 @@ public:
     bool useHyprlandIPC = true;           // Use Hyprland IPC instead of ext_workspaces protocol (Less buggy, but also less performant)
     bool enableSNI = true;                // Enable tray icon
     bool sensorTooltips = false;          // Use tooltips instead of sliders for the sensors
+    bool useUPower = false;               // Use UPower instead of the battery folder. Combines all batteries and shows peripherals
+    bool cacheVerticalText = false;       // Draw texts of vertical bars from cached renderings instead of rotated labels. Ignores label CSS.
+    bool sensorCluster = true;            // Draw consecutive sensors as one widget, instead of one widget per sensor
 
     // Controls for color progression of the network widget
     uint32_t minUploadBytes = 0;                  // Bottom limit of the network widgets upload. Everything below it is considered "under"
@@ -100,6 +103,8 @@ public:
 
     bool hasNet = true;
 
+    bool hasUPower = true;
+
     bool hasPackagesScript = true;
 
     static RuntimeConfig& Get();
@@ -0,0 +1,320 @@
+#include "DBus.h"
+
+#include <algorithm>
+#include <atomic>
+#include <sys/resource.h>
+
+namespace DBus
+{
+    static GDBusConnection* systemConnection = nullptr;
+    static GDBusConnection* sessionConnection = nullptr;
+    static bool systemFailed = false;
+    static bool sessionFailed = false;
+    static guint systemFilterID = 0;
+    static guint sessionFilterID = 0;
+
+    // One route per match rule on the bus
+    struct Route
+    {
+        std::string key;
+        Bus bus;
+        guint gdbusID = 0;
+        std::vector<SubscriptionID> listeners;
+        // The last listener left during a dispatch. The route is erased after the dispatch, so DispatchSignal never touches a freed route.
+        bool removed = false;
+        uint32_t dispatching = 0;
+        uint64_t dispatched = 0;
+        // Time spent in the listeners
+        uint64_t handlerUs = 0;
+        uint64_t maxHandlerUs = 0;
+    };
+    struct Listener
+    {
+        std::string routeKey;
+        std::string path;
+        SignalCallback callback;
+    };
+
+    // Keyed by bus, sender, interface and signal. References into an unordered_map stay valid, so the gdbus callbacks get the route directly.
+    static std::unordered_map<std::string, Route> routes;
+    static std::unordered_map<SubscriptionID, Listener> listeners;
+    static SubscriptionID curID = 0;
+
+    static std::unordered_map<std::string, CallStats> callStats;
+
+    // All messages on our connections, including the ones nobody listens to. Counted on the gdbus worker thread.
+    static std::atomic<uint64_t> messagesIn[2];
+    static std::atomic<uint64_t> messagesOut[2];
+    static int64_t statsStart = 0;
+
+    static GDBusMessage* CountMessage(GDBusConnection*, GDBusMessage* message, gboolean incoming, void* data)
+    {
+        size_t bus = (size_t)data;
+        (incoming ? messagesIn : messagesOut)[bus].fetch_add(1, std::memory_order_relaxed);
+        return message;
+    }
+
+    GDBusConnection* Get(Bus bus)
+    {
+        GDBusConnection*& connection = bus == Bus::System ? systemConnection : sessionConnection;
+        bool& failed = bus == Bus::System ? systemFailed : sessionFailed;
+        if (connection || failed)
+        {
+            return connection;
+        }
+
+        GError* err = nullptr;
+        connection = g_bus_get_sync(bus == Bus::System ? G_BUS_TYPE_SYSTEM : G_BUS_TYPE_SESSION, nullptr, &err);
+        if (!connection)
+        {
+            LOG("DBus: Can't connect to the " << (bus == Bus::System ? "system" : "session") << " bus: " << err->message);
+            g_error_free(err);
+            // Don't try again every time
+            failed = true;
+            return nullptr;
+        }
+        if (!statsStart)
+        {
+            statsStart = g_get_monotonic_time();
+        }
+        (bus == Bus::System ? systemFilterID : sessionFilterID) = g_dbus_connection_add_filter(connection, CountMessage, (void*)(size_t)bus, nullptr);
+        return connection;
+    }
+
+    static void DispatchSignal(GDBusConnection*, const char* sender, const char* path, const char* interface, const char* signal, GVariant* params,
+                               void* data)
+    {
+        Route* route = (Route*)data;
+        route->dispatched++;
+        route->dispatching++;
+        int64_t start = g_get_monotonic_time();
+
+        // Listeners may unsubscribe from within their callback
+        std::vector<SubscriptionID> ids = route->listeners;
+        for (SubscriptionID id : ids)
+        {
+            auto it = listeners.find(id);
+            if (it == listeners.end())
+            {
+                continue;
+            }
+            if (!it->second.path.empty() && it->second.path != path)
+            {
+                continue;
+            }
+            it->second.callback(sender, path, interface, signal, params);
+        }
+
+        uint64_t us = g_get_monotonic_time() - start;
+        route->handlerUs += us;
+        route->maxHandlerUs = std::max(route->maxHandlerUs, us);
+        route->dispatching--;
+        if (route->removed && !route->dispatching)
+        {
+            // Not by route->key, which is freed by the erase
+            std::string key = route->key;
+            routes.erase(key);
+        }
+    }
+
+    SubscriptionID Subscribe(Bus bus, const char* sender, const char* interface, const char* signal, const char* path, SignalCallback&& callback)
+    {
+        GDBusConnection* connection = Get(bus);
+        if (!connection)
+        {
+            return 0;
+        }
+
+        std::string key = std::to_string((int)bus) + "|" + (sender ? sender : "") + "|" + (interface ? interface : "") + "|" + (signal ? signal : "");
+        auto routeIt = routes.find(key);
+        if (routeIt == routes.end())
+        {
+            routeIt = routes.emplace(key, Route{}).first;
+            routeIt->second.key = key;
+            routeIt->second.bus = bus;
+        }
+        Route& route = routeIt->second;
+        if (!route.gdbusID)
+        {
+            // New, or removed during its dispatch and subscribed again right away
+            route.removed = false;
+            route.gdbusID = g_dbus_connection_signal_subscribe(connection, sender, interface, signal, nullptr, nullptr, G_DBUS_SIGNAL_FLAGS_NONE,
+                                                               DispatchSignal, &route, nullptr);
+        }
+
+        SubscriptionID id = ++curID;
+        route.listeners.push_back(id);
+        listeners[id] = {key, path ? path : "", std::move(callback)};
+        return id;
+    }
+
+    void Unsubscribe(SubscriptionID id)
+    {
+        auto it = listeners.find(id);
+        if (it == listeners.end())
+        {
+            return;
+        }
+        auto routeIt = routes.find(it->second.routeKey);
+        listeners.erase(it);
+        if (routeIt == routes.end())
+        {
+            return;
+        }
+
+        Route& route = routeIt->second;
+        route.listeners.erase(std::remove(route.listeners.begin(), route.listeners.end(), id), route.listeners.end());
+        if (route.listeners.empty())
+        {
+            // Last one, drop the match rule
+            g_dbus_connection_signal_unsubscribe(Get(route.bus), route.gdbusID);
+            route.gdbusID = 0;
+            if (route.dispatching)
+            {
+                route.removed = true;
+                return;
+            }
+            routes.erase(routeIt);
+        }
+    }
+
+    struct PendingCall
+    {
+        std::string key;
+        int64_t start;
+        CallCallback callback;
+    };
+
+    static void OnCallFinished(GObject* source, GAsyncResult* res, void* data)
+    {
+        PendingCall* call = (PendingCall*)data;
+
+        GError* err = nullptr;
+        GVariant* reply = g_dbus_connection_call_finish((GDBusConnection*)source, res, &err);
+
+        uint64_t us = g_get_monotonic_time() - call->start;
+        CallStats& stats = callStats[call->key];
+        stats.calls++;
+        stats.totalUs += us;
+        stats.maxUs = std::max(stats.maxUs, us);
+        if (!reply)
+        {
+            stats.failed++;
+            LOG("DBus: " << call->key << " failed: " << err->message);
+            g_error_free(err);
+        }
+
+        if (call->callback)
+        {
+            call->callback(reply);
+        }
+        if (reply)
+        {
+            g_variant_unref(reply);
+        }
+        delete call;
+    }
+
+    void Call(Bus bus, const char* name, const char* path, const char* interface, const char* method, GVariant* params,
+              const GVariantType* replyType, CallCallback&& callback, int32_t timeoutMS)
+    {
+        GDBusConnection* connection = Get(bus);
+        if (!connection)
+        {
+            if (params)
+            {
+                g_variant_unref(g_variant_ref_sink(params));
+            }
+            if (callback)
+            {
+                callback(nullptr);
+            }
+            return;
+        }
+
+        PendingCall* call = new PendingCall{std::string(interface) + "." + method, g_get_monotonic_time(), std::move(callback)};
+        g_dbus_connection_call(connection, name, path, interface, method, params, replyType, G_DBUS_CALL_FLAGS_NONE, timeoutMS, nullptr,
+                               OnCallFinished, call);
+    }
+
+    void CallVoid(Bus bus, const char* name, const char* path, const char* interface, const char* method, GVariant* params,
+                  std::function<void(bool)>&& callback, int32_t timeoutMS)
+    {
+        Call(
+            bus, name, path, interface, method, params, nullptr,
+            [callback = std::move(callback)](GVariant* reply)
+            {
+                if (callback)
+                {
+                    callback(reply != nullptr);
+                }
+            },
+            timeoutMS);
+    }
+
+    const std::unordered_map<std::string, CallStats>& GetCallStats()
+    {
+        return callStats;
+    }
+
+    MessageStats GetMessageStats(Bus bus)
+    {
+        return {messagesIn[(size_t)bus].load(), messagesOut[(size_t)bus].load()};
+    }
+
+    void LogStats()
+    {
+        std::vector<std::pair<std::string, CallStats>> sorted(callStats.begin(), callStats.end());
+        std::sort(sorted.begin(), sorted.end(),
+                  [](auto& a, auto& b)
+                  {
+                      return a.second.totalUs > b.second.totalUs;
+                  });
+        double seconds = statsStart ? (g_get_monotonic_time() - statsStart) / 1000000.0 : 0;
+        rusage usage{};
+        getrusage(RUSAGE_SELF, &usage);
+        double cpuSeconds = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+        LOG("DBus: " << seconds << "s, process cpu time " << cpuSeconds << "s");
+        for (size_t bus = 0; bus < 2; bus++)
+        {
+            LOG("DBus: " << (bus == (size_t)Bus::System ? "System" : "Session") << " bus: " << messagesIn[bus].load() << " messages in, "
+                         << messagesOut[bus].load() << " out");
+        }
+        LOG("DBus: " << routes.size() << " match rules, " << listeners.size() << " listeners");
+        for (auto& [key, route] : routes)
+        {
+            LOG("DBus: Signal " << key << ": " << route.dispatched << " dispatched to " << route.listeners.size() << " listeners, avg "
+                                << (route.dispatched ? route.handlerUs / route.dispatched : 0) << "us, max " << route.maxHandlerUs << "us");
+        }
+        for (auto& [key, stats] : sorted)
+        {
+            LOG("DBus: Call " << key << ": " << stats.calls << " calls (" << stats.failed << " failed), avg "
+                              << (stats.calls ? stats.totalUs / stats.calls : 0) << "us, max " << stats.maxUs << "us");
+        }
+    }
+
+    void Shutdown()
+    {
+        LogStats();
+        for (auto& [key, route] : routes)
+        {
+            if (route.gdbusID)
+                g_dbus_connection_signal_unsubscribe(Get(route.bus), route.gdbusID);
+        }
+        routes.clear();
+        listeners.clear();
+
+        if (systemConnection)
+        {
+            g_dbus_connection_remove_filter(systemConnection, systemFilterID);
+            g_object_unref(systemConnection);
+            systemConnection = nullptr;
+        }
+        if (sessionConnection)
+        {
+            g_dbus_connection_remove_filter(sessionConnection, sessionFilterID);
+            g_object_unref(sessionConnection);
+            sessionConnection = nullptr;
+        }
+    }
+}
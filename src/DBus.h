@@ -0,0 +1,60 @@
+#pragma once
+#include "Common.h"
+
+#include <gio/gio.h>
+#include <functional>
+
+// Owns the one system and one session bus connection of gBar.
+// All signals are routed through a single table, so subscribers interested in the same signal share one match rule on the bus.
+// All callbacks are dispatched on the main context.
+namespace DBus
+{
+    enum class Bus
+    {
+        System,
+        Session
+    };
+
+    // Connects on first use. Returns nullptr, if the bus is not available.
+    GDBusConnection* Get(Bus bus);
+
+    using SubscriptionID = uint32_t;
+    // sender, path, interface, signal, parameters
+    using SignalCallback = std::function<void(const char*, const char*, const char*, const char*, GVariant*)>;
+
+    // sender, interface and signal make up the match rule on the bus and may be nullptr to match anything.
+    // path only filters locally, so listeners of different objects of the same service share the match rule.
+    SubscriptionID Subscribe(Bus bus, const char* sender, const char* interface, const char* signal, const char* path, SignalCallback&& callback);
+    void Unsubscribe(SubscriptionID id);
+
+    // The reply, or nullptr if the call failed. Errors are already logged. Don't unref the reply, it is freed after the callback.
+    using CallCallback = std::function<void(GVariant*)>;
+
+    // Asynchronous method call, params is consumed if floating. replyType may be nullptr to skip type checking.
+    void Call(Bus bus, const char* name, const char* path, const char* interface, const char* method, GVariant* params,
+              const GVariantType* replyType, CallCallback&& callback, int32_t timeoutMS = -1);
+    // For methods without a return value
+    void CallVoid(Bus bus, const char* name, const char* path, const char* interface, const char* method, GVariant* params,
+                  std::function<void(bool)>&& callback = {}, int32_t timeoutMS = -1);
+
+    struct CallStats
+    {
+        uint64_t calls = 0;
+        uint64_t failed = 0;
+        uint64_t totalUs = 0;
+        uint64_t maxUs = 0;
+    };
+    // Keyed by interface.method
+    const std::unordered_map<std::string, CallStats>& GetCallStats();
+
+    struct MessageStats
+    {
+        uint64_t in = 0;
+        uint64_t out = 0;
+    };
+    // All messages on the connection to bus, including the ones nobody listens to
+    MessageStats GetMessageStats(Bus bus);
+    void LogStats();
+
+    void Shutdown();
+}
@@ -0,0 +1,894 @@
+#include "IconTheme.h"
+
+#include <gtk/gtk.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace IconTheme
+{
+    // Bump, whenever the layout below changes
+    constexpr uint32_t cacheVersion = 2;
+    constexpr char cacheMagic[4] = {'G', 'B', 'I', 'C'};
+    // How often a lookup miss may check, whether icons were installed in the meantime
+    constexpr int64_t revalidateIntervalUs = 10 * 1000 * 1000;
+
+    // Cache layout. All offsets are in bytes from the start of the file, except strings, which are relative to Header::strings.
+    // Every section is 8 byte aligned, the strings come last.
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t size;
+        uint32_t themeName;
+        uint32_t numStamps;
+        uint32_t stamps;
+        uint32_t numDirs;
+        uint32_t dirs;
+        uint32_t numNames;
+        uint32_t names;
+        uint32_t numEntries;
+        uint32_t entries;
+        uint32_t numBuckets;
+        uint32_t buckets;
+        uint32_t strings;
+        uint32_t stringsSize;
+    };
+    // mtime of an indexed directory when the index was built
+    struct Stamp
+    {
+        uint32_t path;
+        uint32_t pad;
+        int64_t mtime;
+    };
+    // https://specifications.freedesktop.org/icon-theme-spec/latest/#directory_layout
+    enum class DirType : uint32_t
+    {
+        Fixed,
+        Scalable,
+        Threshold
+    };
+    struct Dir
+    {
+        uint32_t path;
+        // Lower is preferred: The current theme, then the themes it inherits from, then everything else
+        uint32_t themeRank;
+        DirType type;
+        int32_t size;
+        int32_t minSize;
+        int32_t maxSize;
+        int32_t threshold;
+        uint32_t pad;
+    };
+    struct Name
+    {
+        uint32_t name;
+        uint32_t firstEntry;
+        uint32_t numEntries;
+        uint32_t pad;
+    };
+    struct Entry
+    {
+        uint32_t dir;
+        // File name including the extension
+        uint32_t file;
+    };
+
+    // Either mapped from the cache file, or memoryIndex if the cache couldn't be written
+    static const uint8_t* data = nullptr;
+    static size_t dataSize = 0;
+    static bool mapped = false;
+    static std::vector<uint8_t> memoryIndex;
+    static bool initialized = false;
+    static int64_t lastValidation = 0;
+
+    struct LookupResult
+    {
+        std::string path;
+        // False for results of FindPartial and misses, an exact match may show up once the index is rebuilt
+        bool exact;
+    };
+    // Results of Lookup, keyed by name and size. Valid until the index is unloaded, so a miss doesn't search all names every time.
+    constexpr size_t maxLookups = 256;
+    static std::unordered_map<std::string, LookupResult> lookups;
+
+    // Rasterized svgs, keyed like the files in the disk cache. Cleared when full, the disk cache makes refilling it cheap.
+    constexpr size_t maxRasterized = 64;
+    static std::unordered_map<std::string, GdkPixbuf*> rasterized;
+
+    // Bounds of the disk cache. A hit refreshes the mtime of its file, so the least recently used files are removed first.
+    constexpr uint64_t maxDiskCacheBytes = 16 * 1024 * 1024;
+    constexpr int64_t maxDiskCacheAgeS = 30 * 24 * 60 * 60;
+    static bool diskCachePruned = false;
+
+    static uint32_t Hash(const char* str)
+    {
+        // FNV-1a
+        uint32_t hash = 2166136261u;
+        for (; *str; str++)
+        {
+            hash = (hash ^ (uint8_t)*str) * 16777619u;
+        }
+        return hash;
+    }
+
+    static int64_t GetMTime(const std::string& path)
+    {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0)
+        {
+            return -1;
+        }
+        return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+    }
+
+    static std::string GetCurrentThemeName()
+    {
+        GtkSettings* settings = gtk_settings_get_default();
+        if (!settings)
+        {
+            return "hicolor";
+        }
+        char* name = nullptr;
+        g_object_get(settings, "gtk-icon-theme-name", &name, nullptr);
+        std::string result = name ? name : "hicolor";
+        g_free(name);
+        return result;
+    }
+
+    static std::string GetCachePath()
+    {
+        return std::string(g_get_user_cache_dir()) + "/gBar/icon-index";
+    }
+
+    // In order of preference
+    static std::vector<std::string> GetBaseDirs()
+    {
+        std::vector<std::string> baseDirs;
+        auto add = [&](const std::string& dir)
+        {
+            if (std::find(baseDirs.begin(), baseDirs.end(), dir) == baseDirs.end())
+            {
+                baseDirs.push_back(dir);
+            }
+        };
+        const char* home = getenv("HOME");
+        if (home)
+        {
+            add(std::string(home) + "/.icons");
+        }
+        add(std::string(g_get_user_data_dir()) + "/icons");
+        const char* dataDirs = getenv("XDG_DATA_DIRS");
+        if (dataDirs)
+        {
+            for (auto& dataDir : Utils::Split(dataDirs, ':'))
+            {
+                add(dataDir + "/icons");
+            }
+        }
+        add("/usr/share/icons");
+        return baseDirs;
+    }
+
+    // Building
+    struct Builder
+    {
+        std::string strings;
+        std::unordered_map<std::string, uint32_t> stringOffsets;
+        std::vector<Stamp> stamps;
+        std::vector<Dir> dirs;
+        // Sorted, so the same icons always produce the same file
+        std::map<std::string, std::vector<Entry>> names;
+
+        uint32_t AddString(const std::string& str)
+        {
+            auto it = stringOffsets.find(str);
+            if (it != stringOffsets.end())
+            {
+                return it->second;
+            }
+            uint32_t offset = strings.size();
+            strings.append(str.c_str(), str.size() + 1);
+            stringOffsets[str] = offset;
+            return offset;
+        }
+
+        // Returns false, if path doesn't exist
+        bool AddStamp(const std::string& path)
+        {
+            int64_t mtime = GetMTime(path);
+            if (mtime < 0)
+            {
+                return false;
+            }
+            stamps.push_back({AddString(path), 0, mtime});
+            return true;
+        }
+
+        // Adds the png and svg files directly in path
+        void AddDir(const std::string& path, uint32_t themeRank, Dir dir)
+        {
+            if (!AddStamp(path))
+            {
+                return;
+            }
+            std::error_code err;
+            uint32_t dirIndex = UINT32_MAX;
+            for (auto& file : std::filesystem::directory_iterator(path, err))
+            {
+                auto extension = file.path().extension();
+                if ((extension != ".png" && extension != ".svg") || !file.is_regular_file(err))
+                {
+                    continue;
+                }
+                if (dirIndex == UINT32_MAX)
+                {
+                    dirIndex = dirs.size();
+                    dir.path = AddString(path);
+                    dir.themeRank = themeRank;
+                    dirs.push_back(dir);
+                }
+                names[file.path().stem().string()].push_back({dirIndex, AddString(file.path().filename().string())});
+            }
+        }
+
+        void AddTheme(const std::string& themeDir, uint32_t themeRank)
+        {
+            if (!AddStamp(themeDir))
+            {
+                return;
+            }
+            GKeyFile* index = g_key_file_new();
+            if (g_key_file_load_from_file(index, (themeDir + "/index.theme").c_str(), G_KEY_FILE_NONE, nullptr))
+            {
+                gsize numSubdirs = 0;
+                char** subdirs = g_key_file_get_string_list(index, "Icon Theme", "Directories", &numSubdirs, nullptr);
+                for (gsize i = 0; i < numSubdirs; i++)
+                {
+                    const char* subdir = subdirs[i];
+                    // HiDPI variants aren't used by the tray
+                    if (g_key_file_get_integer(index, subdir, "Scale", nullptr) > 1)
+                    {
+                        continue;
+                    }
+                    auto getInt = [&](const char* key, int32_t fallback)
+                    {
+                        return g_key_file_has_key(index, subdir, key, nullptr) ? g_key_file_get_integer(index, subdir, key, nullptr) : fallback;
+                    };
+                    Dir dir{};
+                    dir.size = getInt("Size", 0);
+                    dir.minSize = getInt("MinSize", dir.size);
+                    dir.maxSize = getInt("MaxSize", dir.size);
+                    dir.threshold = getInt("Threshold", 2);
+                    dir.type = DirType::Threshold;
+                    char* type = g_key_file_get_string(index, subdir, "Type", nullptr);
+                    if (type && strcmp(type, "Fixed") == 0)
+                        dir.type = DirType::Fixed;
+                    else if (type && strcmp(type, "Scalable") == 0)
+                        dir.type = DirType::Scalable;
+                    g_free(type);
+                    AddDir(themeDir + "/" + subdir, themeRank, dir);
+                }
+                g_strfreev(subdirs);
+            }
+            else
+            {
+                // No index.theme, guess the sizes from the directory names (e.g. 48x48/apps)
+                std::error_code err;
+                for (auto& subdir : std::filesystem::recursive_directory_iterator(themeDir, err))
+                {
+                    if (!subdir.is_directory(err))
+                    {
+                        continue;
+                    }
+                    Dir dir{};
+                    dir.type = DirType::Threshold;
+                    dir.threshold = 2;
+                    std::string relative = subdir.path().lexically_relative(themeDir).string();
+                    int32_t width = 0, height = 0;
+                    for (auto& component : Utils::Split(relative, '/'))
+                    {
+                        if (sscanf(component.c_str(), "%dx%d", &width, &height) == 2)
+                        {
+                            dir.size = width;
+                        }
+                        else if (component == "scalable")
+                        {
+                            dir.type = DirType::Scalable;
+                            dir.minSize = 1;
+                            dir.maxSize = 512;
+                        }
+                    }
+                    if (dir.type != DirType::Scalable)
+                    {
+                        dir.minSize = dir.maxSize = dir.size;
+                    }
+                    AddDir(subdir.path().string(), themeRank, dir);
+                }
+            }
+            g_key_file_free(index);
+        }
+
+        std::vector<uint8_t> Serialize(const std::string& themeName)
+        {
+            uint32_t themeNameOffset = AddString(themeName);
+
+            std::vector<Name> flatNames;
+            std::vector<Entry> entries;
+            flatNames.reserve(names.size());
+            for (auto& [name, nameEntries] : names)
+            {
+                flatNames.push_back({AddString(name), (uint32_t)entries.size(), (uint32_t)nameEntries.size(), 0});
+                entries.insert(entries.end(), nameEntries.begin(), nameEntries.end());
+            }
+
+            // Open addressing with at most 50% load. Bucket value is the name index + 1, 0 is empty.
+            uint32_t numBuckets = 1;
+            while (numBuckets < flatNames.size() * 2)
+            {
+                numBuckets <<= 1;
+            }
+            std::vector<uint32_t> buckets(numBuckets, 0);
+            for (uint32_t i = 0; i < flatNames.size(); i++)
+            {
+                uint32_t bucket = Hash(strings.c_str() + flatNames[i].name) & (numBuckets - 1);
+                while (buckets[bucket] != 0)
+                {
+                    bucket = (bucket + 1) & (numBuckets - 1);
+                }
+                buckets[bucket] = i + 1;
+            }
+
+            size_t size = sizeof(Header);
+            auto place = [&](size_t bytes) -> uint32_t
+            {
+                size = (size + 7) & ~(size_t)7;
+                uint32_t offset = size;
+                size += bytes;
+                return offset;
+            };
+            Header header{};
+            memcpy(header.magic, cacheMagic, sizeof(cacheMagic));
+            header.version = cacheVersion;
+            header.themeName = themeNameOffset;
+            header.numStamps = stamps.size();
+            header.stamps = place(stamps.size() * sizeof(Stamp));
+            header.numDirs = dirs.size();
+            header.dirs = place(dirs.size() * sizeof(Dir));
+            header.numNames = flatNames.size();
+            header.names = place(flatNames.size() * sizeof(Name));
+            header.numEntries = entries.size();
+            header.entries = place(entries.size() * sizeof(Entry));
+            header.numBuckets = numBuckets;
+            header.buckets = place(buckets.size() * sizeof(uint32_t));
+            header.stringsSize = strings.size();
+            header.strings = place(strings.size());
+            header.size = size;
+
+            std::vector<uint8_t> out(size, 0);
+            memcpy(out.data(), &header, sizeof(Header));
+            memcpy(out.data() + header.stamps, stamps.data(), stamps.size() * sizeof(Stamp));
+            memcpy(out.data() + header.dirs, dirs.data(), dirs.size() * sizeof(Dir));
+            memcpy(out.data() + header.names, flatNames.data(), flatNames.size() * sizeof(Name));
+            memcpy(out.data() + header.entries, entries.data(), entries.size() * sizeof(Entry));
+            memcpy(out.data() + header.buckets, buckets.data(), buckets.size() * sizeof(uint32_t));
+            memcpy(out.data() + header.strings, strings.data(), strings.size());
+            return out;
+        }
+    };
+
+    static std::vector<uint8_t> Build(const std::string& themeName)
+    {
+        std::vector<std::string> baseDirs = GetBaseDirs();
+
+        // Current theme first, then what it inherits from (breadth first) and hicolor last, as the spec wants
+        std::vector<std::string> themes = {themeName};
+        for (size_t i = 0; i < themes.size(); i++)
+        {
+            for (auto& baseDir : baseDirs)
+            {
+                GKeyFile* index = g_key_file_new();
+                if (g_key_file_load_from_file(index, (baseDir + "/" + themes[i] + "/index.theme").c_str(), G_KEY_FILE_NONE, nullptr))
+                {
+                    char** inherits = g_key_file_get_string_list(index, "Icon Theme", "Inherits", nullptr, nullptr);
+                    for (char** parent = inherits; parent && *parent; parent++)
+                    {
+                        if (std::find(themes.begin(), themes.end(), *parent) == themes.end() && strcmp(*parent, "hicolor") != 0)
+                        {
+                            themes.push_back(*parent);
+                        }
+                    }
+                    g_strfreev(inherits);
+                    g_key_file_free(index);
+                    break;
+                }
+                g_key_file_free(index);
+            }
+        }
+        if (themeName != "hicolor")
+        {
+            themes.push_back("hicolor");
+        }
+
+        Builder builder;
+        uint32_t otherRank = themes.size();
+        for (auto& baseDir : baseDirs)
+        {
+            if (!builder.AddStamp(baseDir))
+            {
+                continue;
+            }
+            std::error_code err;
+            for (auto& themeDir : std::filesystem::directory_iterator(baseDir, err))
+            {
+                if (!themeDir.is_directory(err))
+                {
+                    continue;
+                }
+                std::string name = themeDir.path().filename().string();
+                auto themeIt = std::find(themes.begin(), themes.end(), name);
+                builder.AddTheme(themeDir.path().string(), themeIt != themes.end() ? themeIt - themes.begin() : otherRank);
+            }
+            // Icons directly in the base directory
+            builder.AddDir(baseDir, otherRank + 1, Dir{0, 0, DirType::Fixed, 0, 0, 0, 0, 0});
+        }
+        LOG("IconTheme: Indexed " << builder.names.size() << " icons in " << builder.dirs.size() << " directories");
+        return builder.Serialize(themeName);
+    }
+
+    // Lookup
+    static const Header& GetHeader()
+    {
+        return *(const Header*)data;
+    }
+
+    static const char* GetString(uint32_t offset)
+    {
+        const Header& header = GetHeader();
+        return offset < header.stringsSize ? (const char*)data + header.strings + offset : "";
+    }
+
+    template<typename T>
+    static const T* GetSection(uint32_t offset)
+    {
+        return (const T*)(data + offset);
+    }
+
+    static bool IsValid(const std::string& themeName)
+    {
+        if (dataSize < sizeof(Header))
+        {
+            return false;
+        }
+        const Header& header = GetHeader();
+        if (memcmp(header.magic, cacheMagic, sizeof(cacheMagic)) != 0 || header.version != cacheVersion || header.size != dataSize)
+        {
+            return false;
+        }
+        auto fits = [&](uint32_t offset, size_t bytes)
+        {
+            return offset % 8 == 0 && offset + bytes <= dataSize;
+        };
+        if (!fits(header.stamps, header.numStamps * sizeof(Stamp)) || !fits(header.dirs, header.numDirs * sizeof(Dir)) ||
+            !fits(header.names, header.numNames * sizeof(Name)) || !fits(header.entries, header.numEntries * sizeof(Entry)) ||
+            !fits(header.buckets, header.numBuckets * sizeof(uint32_t)) || header.strings + (size_t)header.stringsSize != dataSize ||
+            header.stringsSize == 0 || data[dataSize - 1] != '\0' || header.numBuckets == 0 || (header.numBuckets & (header.numBuckets - 1)) != 0)
+        {
+            LOG("IconTheme: Corrupt icon index");
+            return false;
+        }
+        if (themeName != GetString(header.themeName))
+        {
+            return false;
+        }
+
+        const Stamp* stamps = GetSection<Stamp>(header.stamps);
+        for (uint32_t i = 0; i < header.numStamps; i++)
+        {
+            if (GetMTime(GetString(stamps[i].path)) != stamps[i].mtime)
+            {
+                LOG("IconTheme: " << GetString(stamps[i].path) << " changed");
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void Unload()
+    {
+        if (mapped)
+        {
+            munmap((void*)data, dataSize);
+        }
+        memoryIndex.clear();
+        lookups.clear();
+        data = nullptr;
+        dataSize = 0;
+        mapped = false;
+    }
+
+    static bool Map(const std::string& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header))
+        {
+            close(fd);
+            return false;
+        }
+        void* mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mem == MAP_FAILED)
+        {
+            return false;
+        }
+        data = (const uint8_t*)mem;
+        dataSize = st.st_size;
+        mapped = true;
+        return true;
+    }
+
+    static void Load()
+    {
+        std::string themeName = GetCurrentThemeName();
+        std::string cachePath = GetCachePath();
+        lastValidation = g_get_monotonic_time();
+        if (Map(cachePath))
+        {
+            if (IsValid(themeName))
+            {
+                return;
+            }
+            Unload();
+        }
+
+        LOG("IconTheme: Building icon index for theme " << themeName);
+        std::vector<uint8_t> index = Build(themeName);
+
+        // Write a temporary file and rename it, so a concurrent gBar never maps a half written index
+        std::string cacheDir = cachePath.substr(0, cachePath.find_last_of('/'));
+        g_mkdir_with_parents(cacheDir.c_str(), 0755);
+        std::string tmpPath = cachePath + "." + std::to_string(getpid());
+        std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+        file.write((const char*)index.data(), index.size());
+        file.close();
+        if (file && rename(tmpPath.c_str(), cachePath.c_str()) == 0 && Map(cachePath) && IsValid(themeName))
+        {
+            return;
+        }
+        LOG("IconTheme: Cannot write " << cachePath << ", keeping the index in memory");
+        remove(tmpPath.c_str());
+        Unload();
+        memoryIndex = std::move(index);
+        data = memoryIndex.data();
+        dataSize = memoryIndex.size();
+    }
+
+    // Distance according to the icon theme spec
+    static int32_t SizeDistance(const Dir& dir, int32_t size)
+    {
+        switch (dir.type)
+        {
+        case DirType::Fixed: return std::abs(dir.size - size);
+        case DirType::Scalable:
+            if (size < dir.minSize)
+                return dir.minSize - size;
+            if (size > dir.maxSize)
+                return size - dir.maxSize;
+            return 0;
+        case DirType::Threshold:
+            if (size < dir.size - dir.threshold)
+                return dir.minSize - size;
+            if (size > dir.size + dir.threshold)
+                return size - dir.maxSize;
+            return 0;
+        }
+        return INT32_MAX;
+    }
+
+    // Best entry of name. Lower rank wins, then lower distance.
+    static std::string BestPath(const Name& name, int32_t size, uint32_t& bestRank, int32_t& bestDistance)
+    {
+        const Header& header = GetHeader();
+        const Dir* dirs = GetSection<Dir>(header.dirs);
+        const Entry* entries = GetSection<Entry>(header.entries);
+        const Entry* best = nullptr;
+        for (uint32_t i = name.firstEntry; i < name.firstEntry + name.numEntries && i < header.numEntries; i++)
+        {
+            if (entries[i].dir >= header.numDirs)
+            {
+                continue;
+            }
+            const Dir& dir = dirs[entries[i].dir];
+            int32_t distance = SizeDistance(dir, size);
+            if (dir.themeRank < bestRank || (dir.themeRank == bestRank && distance < bestDistance))
+            {
+                best = &entries[i];
+                bestRank = dir.themeRank;
+                bestDistance = distance;
+            }
+        }
+        if (!best)
+        {
+            return "";
+        }
+        return std::string(GetString(dirs[best->dir].path)) + "/" + GetString(best->file);
+    }
+
+    static std::string Find(const std::string& name, int32_t size)
+    {
+        const Header& header = GetHeader();
+        const Name* names = GetSection<Name>(header.names);
+        const uint32_t* buckets = GetSection<uint32_t>(header.buckets);
+        uint32_t mask = header.numBuckets - 1;
+        uint32_t bucket = Hash(name.c_str()) & mask;
+        for (uint32_t probes = 0; probes < header.numBuckets && buckets[bucket] != 0; probes++)
+        {
+            uint32_t nameIndex = buckets[bucket] - 1;
+            if (nameIndex < header.numNames && name == GetString(names[nameIndex].name))
+            {
+                uint32_t rank = UINT32_MAX;
+                int32_t distance = INT32_MAX;
+                return BestPath(names[nameIndex], size, rank, distance);
+            }
+            bucket = (bucket + 1) & mask;
+        }
+        return "";
+    }
+
+    // Icons, whose name only contains name. Some items send names, which don't match their files exactly.
+    static std::string FindPartial(const std::string& name, int32_t size)
+    {
+        const Header& header = GetHeader();
+        const Name* names = GetSection<Name>(header.names);
+        uint32_t rank = UINT32_MAX;
+        int32_t distance = INT32_MAX;
+        std::string best;
+        for (uint32_t i = 0; i < header.numNames; i++)
+        {
+            if (strstr(GetString(names[i].name), name.c_str()))
+            {
+                std::string path = BestPath(names[i], size, rank, distance);
+                if (!path.empty())
+                {
+                    best = std::move(path);
+                }
+            }
+        }
+        return best;
+    }
+
+    // Reloads the index, if icons may have been installed since it was built. Returns true, if it was reloaded.
+    static bool Revalidate()
+    {
+        if (g_get_monotonic_time() - lastValidation <= revalidateIntervalUs)
+        {
+            return false;
+        }
+        lastValidation = g_get_monotonic_time();
+        if (IsValid(GetCurrentThemeName()))
+        {
+            return false;
+        }
+        Unload();
+        Load();
+        return true;
+    }
+
+    std::string Lookup(const std::string& name, int32_t size)
+    {
+        if (!initialized)
+        {
+            initialized = true;
+            Load();
+        }
+        if (name.empty())
+        {
+            return "";
+        }
+
+        std::string key = name + "|" + std::to_string(size);
+        auto it = lookups.find(key);
+        if (it != lookups.end() && (it->second.exact || !Revalidate()))
+        {
+            return it->second.path;
+        }
+
+        LookupResult result{Find(name, size), true};
+        if (result.path.empty() && Revalidate())
+        {
+            // Maybe it was installed after the index was built
+            result.path = Find(name, size);
+        }
+        if (result.path.empty())
+        {
+            result.path = FindPartial(name, size);
+            result.exact = false;
+        }
+        if (lookups.size() >= maxLookups)
+        {
+            lookups.clear();
+        }
+        lookups[key] = result;
+        return result.path;
+    }
+
+    bool IsSymbolic(const std::string& path)
+    {
+        size_t extension = path.find_last_of('.');
+        constexpr const char* suffix = "-symbolic";
+        return extension != std::string::npos && extension >= strlen(suffix) &&
+               path.compare(extension - strlen(suffix), strlen(suffix), suffix) == 0;
+    }
+
+    // Symbolic icons are monochrome, only their alpha matters
+    static void Recolor(GdkPixbuf* pixbuf, uint32_t color)
+    {
+        uint8_t r = (color >> 16) & 0xff;
+        uint8_t g = (color >> 8) & 0xff;
+        uint8_t b = color & 0xff;
+        int width = gdk_pixbuf_get_width(pixbuf);
+        int height = gdk_pixbuf_get_height(pixbuf);
+        int stride = gdk_pixbuf_get_rowstride(pixbuf);
+        uint8_t* pixels = gdk_pixbuf_get_pixels(pixbuf);
+        for (int y = 0; y < height; y++)
+        {
+            uint8_t* pixel = pixels + (size_t)y * stride;
+            for (int x = 0; x < width; x++, pixel += 4)
+            {
+                pixel[0] = r;
+                pixel[1] = g;
+                pixel[2] = b;
+            }
+        }
+    }
+
+    // Runs once, when the first svg is rasterized. Only misses add files.
+    static void PruneDiskCache(const std::string& cacheDir)
+    {
+        struct CachedFile
+        {
+            std::string path;
+            int64_t mtime;
+            uint64_t size;
+        };
+        std::vector<CachedFile> files;
+        uint64_t totalSize = 0;
+        int64_t now = g_get_real_time() / 1000000;
+        std::error_code err;
+        for (auto& file : std::filesystem::directory_iterator(cacheDir, err))
+        {
+            struct stat st;
+            if (file.path().extension() != ".png" || stat(file.path().c_str(), &st) != 0)
+            {
+                continue;
+            }
+            if (now - st.st_mtim.tv_sec > maxDiskCacheAgeS)
+            {
+                remove(file.path().c_str());
+                continue;
+            }
+            files.push_back({file.path().string(), st.st_mtim.tv_sec, (uint64_t)st.st_size});
+            totalSize += st.st_size;
+        }
+        if (totalSize <= maxDiskCacheBytes)
+        {
+            return;
+        }
+        std::sort(files.begin(), files.end(),
+                  [](const CachedFile& a, const CachedFile& b)
+                  {
+                      return a.mtime < b.mtime;
+                  });
+        for (auto& file : files)
+        {
+            if (totalSize <= maxDiskCacheBytes)
+            {
+                break;
+            }
+            remove(file.path.c_str());
+            totalSize -= file.size;
+        }
+        LOG("IconTheme: Pruned " << cacheDir << " to " << totalSize << " bytes");
+    }
+
+    GdkPixbuf* LoadSVG(const std::string& path, int32_t pixels, uint32_t color)
+    {
+        int64_t mtime = GetMTime(path);
+        if (mtime < 0)
+        {
+            return nullptr;
+        }
+        bool symbolic = IsSymbolic(path);
+        std::string key = path + "|" + std::to_string(mtime) + "|" + std::to_string(pixels) + "|" + std::to_string(symbolic ? color : 0);
+
+        auto it = rasterized.find(key);
+        if (it != rasterized.end())
+        {
+            return (GdkPixbuf*)g_object_ref(it->second);
+        }
+
+        char* hash = g_compute_checksum_for_string(G_CHECKSUM_SHA1, key.c_str(), key.size());
+        std::string cacheDir = std::string(g_get_user_cache_dir()) + "/gBar/icons";
+        std::string cachePath = cacheDir + "/" + hash + ".png";
+        g_free(hash);
+
+        // A png of the exact size decodes a lot faster than the svg renders
+        GdkPixbuf* pixbuf = gdk_pixbuf_new_from_file(cachePath.c_str(), nullptr);
+        if (pixbuf)
+        {
+            // Recently used, for PruneDiskCache
+            utimensat(AT_FDCWD, cachePath.c_str(), nullptr, 0);
+        }
+        else
+        {
+            GError* err = nullptr;
+            pixbuf = gdk_pixbuf_new_from_file_at_scale(path.c_str(), pixels, pixels, true, &err);
+            if (!pixbuf)
+            {
+                LOG("IconTheme: Cannot rasterize " << path << ": " << (err ? err->message : "unknown error"));
+                if (err)
+                    g_error_free(err);
+                return nullptr;
+            }
+            if (!gdk_pixbuf_get_has_alpha(pixbuf))
+            {
+                GdkPixbuf* withAlpha = gdk_pixbuf_add_alpha(pixbuf, false, 0, 0, 0);
+                g_object_unref(pixbuf);
+                pixbuf = withAlpha;
+            }
+            if (symbolic)
+            {
+                Recolor(pixbuf, color);
+            }
+
+            // Write a temporary file and rename it, like the index
+            g_mkdir_with_parents(cacheDir.c_str(), 0755);
+            std::string tmpPath = cachePath + "." + std::to_string(getpid());
+            if (gdk_pixbuf_save(pixbuf, tmpPath.c_str(), "png", nullptr, nullptr) && rename(tmpPath.c_str(), cachePath.c_str()) == 0)
+            {
+                LOG("IconTheme: Rasterized " << path << " to " << pixels << "px");
+            }
+            else
+            {
+                remove(tmpPath.c_str());
+            }
+            if (!diskCachePruned)
+            {
+                diskCachePruned = true;
+                PruneDiskCache(cacheDir);
+            }
+        }
+
+        if (rasterized.size() >= maxRasterized)
+        {
+            for (auto& [cachedKey, cached] : rasterized)
+            {
+                g_object_unref(cached);
+            }
+            rasterized.clear();
+        }
+        rasterized[key] = (GdkPixbuf*)g_object_ref(pixbuf);
+        return pixbuf;
+    }
+
+    void Shutdown()
+    {
+        Unload();
+        for (auto& [key, pixbuf] : rasterized)
+        {
+            g_object_unref(pixbuf);
+        }
+        rasterized.clear();
+        initialized = false;
+    }
+}
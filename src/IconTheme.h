@@ -0,0 +1,24 @@
+#pragma once
+#include "Common.h"
+
+#include <gtk/gtk.h>
+
+// Index of all icons of the installed icon themes, so looking up an icon by name doesn't need to walk the icon directories.
+// The index is built once and persisted in $XDG_CACHE_HOME/gBar/icon-index, which is mapped into memory on startup.
+// It is rebuilt, when any of the indexed directories changed.
+namespace IconTheme
+{
+    // Path to the png or svg for name, which fits size best. Icons of the current gtk icon theme (and the themes it inherits from) are preferred,
+    // other themes are used as fallback. Returns "" if nothing was found.
+    std::string Lookup(const std::string& name, int32_t size);
+
+    // Renders the svg at path to pixels x pixels. Symbolic icons (*-symbolic.svg) are recolored with color (0xRRGGBB).
+    // Results are cached in memory and in $XDG_CACHE_HOME/gBar/icons, keyed by path, mtime, size and color, so each svg is only rendered once.
+    // Files unused for 30 days are removed from the disk cache, and it is kept below 16 MiB.
+    // Returns a new reference, or nullptr on failure.
+    GdkPixbuf* LoadSVG(const std::string& path, int32_t pixels, uint32_t color);
+    // Whether path is a *-symbolic icon, which LoadSVG draws in the given color
+    bool IsSymbolic(const std::string& path);
+
+    void Shutdown();
+}
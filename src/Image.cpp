@@ -0,0 +1,199 @@
+#include "Image.h"
+
+#ifdef HAS_STB
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+#endif
+
+#include <gio/gio.h>
+#include <algorithm>
+#include <cstring>
+
+#if defined __SSE2__
+#include <immintrin.h>
+#elif defined __ARM_NEON && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#include <arm_neon.h>
+#endif
+
+namespace Image
+{
+    cairo_surface_t* DecodeScaled(const uint8_t* data, size_t length, int32_t size)
+    {
+#ifdef HAS_STB
+        int width, height, channels;
+        stbi_uc* pixels = stbi_load_from_memory(data, (int)length, &width, &height, &channels, STBI_rgb_alpha);
+        if (!pixels)
+        {
+            LOG("Image: Cannot decode image: " << stbi_failure_reason());
+            return nullptr;
+        }
+
+        cairo_surface_t* full = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+        if (cairo_surface_status(full) != CAIRO_STATUS_SUCCESS)
+        {
+            LOG("Image: Cannot create " << width << "x" << height << " surface");
+            cairo_surface_destroy(full);
+            stbi_image_free(pixels);
+            return nullptr;
+        }
+        // Cairo wants premultiplied ARGB in native endianess
+        cairo_surface_flush(full);
+        uint8_t* dst = cairo_image_surface_get_data(full);
+        int stride = cairo_image_surface_get_stride(full);
+        for (int y = 0; y < height; y++)
+        {
+            uint32_t* row = (uint32_t*)(dst + (size_t)y * stride);
+            const stbi_uc* src = pixels + (size_t)y * width * 4;
+            for (int x = 0; x < width; x++)
+            {
+                uint32_t a = src[x * 4 + 3];
+                uint32_t r = src[x * 4 + 0] * a / 255;
+                uint32_t g = src[x * 4 + 1] * a / 255;
+                uint32_t b = src[x * 4 + 2] * a / 255;
+                row[x] = (a << 24) | (r << 16) | (g << 8) | b;
+            }
+        }
+        cairo_surface_mark_dirty(full);
+        stbi_image_free(pixels);
+
+        double scale = (double)size / std::max(width, height);
+        if (scale >= 1)
+        {
+            // Already small enough
+            return full;
+        }
+        int scaledWidth = std::max(1, (int)(width * scale));
+        int scaledHeight = std::max(1, (int)(height * scale));
+        cairo_surface_t* scaled = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, scaledWidth, scaledHeight);
+        cairo_t* cr = cairo_create(scaled);
+        cairo_scale(cr, (double)scaledWidth / width, (double)scaledHeight / height);
+        cairo_set_source_surface(cr, full, 0, 0);
+        cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_GOOD);
+        cairo_paint(cr);
+        cairo_destroy(cr);
+        cairo_surface_destroy(full);
+        return scaled;
+#else
+        (void)data;
+        (void)length;
+        (void)size;
+        return nullptr;
+#endif
+    }
+
+    void ARGBToRGBA(const uint8_t* src, uint8_t* dst, size_t numPixels)
+    {
+        // Loaded as little endian uint32, a pixel is 0xBBGGRRAA and needs to become 0xAABBGGRR, so it's just a rotation by 8 bits.
+        size_t i = 0;
+#if defined __AVX2__
+        for (; i + 8 <= numPixels; i += 8)
+        {
+            __m256i px = _mm256_loadu_si256((const __m256i*)(src + i * 4));
+            _mm256_storeu_si256((__m256i*)(dst + i * 4), _mm256_or_si256(_mm256_srli_epi32(px, 8), _mm256_slli_epi32(px, 24)));
+        }
+#endif
+#if defined __SSE2__
+        // Baseline on x86_64
+        for (; i + 4 <= numPixels; i += 4)
+        {
+            __m128i px = _mm_loadu_si128((const __m128i*)(src + i * 4));
+            _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_or_si128(_mm_srli_epi32(px, 8), _mm_slli_epi32(px, 24)));
+        }
+#elif defined __ARM_NEON && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        for (; i + 4 <= numPixels; i += 4)
+        {
+            uint32x4_t px = vreinterpretq_u32_u8(vld1q_u8(src + i * 4));
+            // (px << 24) | (px >> 8)
+            vst1q_u8(dst + i * 4, vreinterpretq_u8_u32(vsriq_n_u32(vshlq_n_u32(px, 24), px, 8)));
+        }
+#endif
+        for (; i < numPixels; i++)
+        {
+            uint32_t px;
+            memcpy(&px, src + i * 4, 4);
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+            px = (px << 8) | (px >> 24);
+#else
+            px = (px >> 8) | (px << 24);
+#endif
+            memcpy(dst + i * 4, &px, 4);
+        }
+    }
+
+    struct LoadRequest
+    {
+        std::string uri;
+        int32_t size;
+        std::function<void(cairo_surface_t*)> callback;
+    };
+
+    void LoadScaledAsync(const std::string& uri, int32_t size, std::function<void(cairo_surface_t*)>&& callback)
+    {
+        auto onLoaded = [](GObject* source, GAsyncResult* res, void* data)
+        {
+            LoadRequest* request = (LoadRequest*)data;
+            char* contents = nullptr;
+            gsize length = 0;
+            GError* err = nullptr;
+            cairo_surface_t* surface = nullptr;
+            if (g_file_load_contents_finish((GFile*)source, res, &contents, &length, nullptr, &err))
+            {
+                surface = DecodeScaled((const uint8_t*)contents, length, request->size);
+                g_free(contents);
+            }
+            else
+            {
+                LOG("Image: Cannot load " << request->uri << ": " << err->message);
+                g_error_free(err);
+            }
+            request->callback(surface);
+            delete request;
+            g_object_unref(source);
+        };
+
+        GFile* file = g_file_new_for_uri(uri.c_str());
+        g_file_load_contents_async(file, nullptr, +onLoaded, new LoadRequest{uri, size, std::move(callback)});
+    }
+
+    SurfaceCache::~SurfaceCache()
+    {
+        for (auto& [key, surface] : m_Entries)
+        {
+            cairo_surface_destroy(surface);
+        }
+    }
+
+    cairo_surface_t* SurfaceCache::Get(const std::string& key)
+    {
+        auto it = m_Lookup.find(key);
+        if (it == m_Lookup.end())
+        {
+            return nullptr;
+        }
+        // Move to front
+        m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+        return it->second->second;
+    }
+
+    void SurfaceCache::Put(const std::string& key, cairo_surface_t* surface)
+    {
+        auto it = m_Lookup.find(key);
+        if (it != m_Lookup.end())
+        {
+            cairo_surface_destroy(it->second->second);
+            it->second->second = surface;
+            m_Entries.splice(m_Entries.begin(), m_Entries, it->second);
+            return;
+        }
+
+        m_Entries.emplace_front(key, surface);
+        m_Lookup[key] = m_Entries.begin();
+        if (m_Entries.size() > m_Capacity)
+        {
+            auto& [lruKey, lruSurface] = m_Entries.back();
+            cairo_surface_destroy(lruSurface);
+            m_Lookup.erase(lruKey);
+            m_Entries.pop_back();
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include "Common.h"
+
+#include <gtk/gtk.h>
+#include <functional>
+#include <list>
+
+namespace Image
+{
+    // Decodes an encoded image (png, jpg, ...) and scales it down to fit into size x size, keeping the aspect ratio.
+    // Returns nullptr on failure. The caller owns the surface.
+    cairo_surface_t* DecodeScaled(const uint8_t* data, size_t length, int32_t size);
+
+    // Loads and decodes uri (file://, or http(s):// if gvfs is available) without blocking the main loop.
+    // callback is called on the main context with the surface (Owned by the callback) or nullptr on failure.
+    void LoadScaledAsync(const std::string& uri, int32_t size, std::function<void(cairo_surface_t*)>&& callback);
+
+    // Converts ARGB32 in network byte order (StatusNotifierItem pixmaps) to RGBA32 as used by GdkPixbuf. src and dst may be the same.
+    void ARGBToRGBA(const uint8_t* src, uint8_t* dst, size_t numPixels);
+
+    // Small LRU of decoded surfaces, so images that were already shown don't need to be decoded again. Owns the surfaces.
+    class SurfaceCache
+    {
+    public:
+        SurfaceCache(size_t capacity) : m_Capacity(capacity) {}
+        ~SurfaceCache();
+
+        // nullptr if not cached. Marks the entry as recently used.
+        cairo_surface_t* Get(const std::string& key);
+        // Takes ownership of surface. May evict the least recently used surface, so don't hold on to surfaces from Get across a Put.
+        void Put(const std::string& key, cairo_surface_t* surface);
+
+    private:
+        size_t m_Capacity;
+        // Front is the most recently used
+        std::list<std::pair<std::string, cairo_surface_t*>> m_Entries;
+        std::unordered_map<std::string, std::list<std::pair<std::string, cairo_surface_t*>>::iterator> m_Lookup;
+    };
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "Common.h"
+#include "DBus.h"
+
+#include <gio/gio.h>
+#include <cstdlib>
+#include <functional>
+
+// Power actions and sleep notifications through org.freedesktop.login1 (systemd-logind or elogind)
+namespace Logind
+{
+    static std::function<void(bool)> prepareForSleepCallback;
+    static DBus::SubscriptionID prepareForSleepID = 0;
+
+    inline void PrepareForSleep(const char*, const char*, const char*, const char*, GVariant* params)
+    {
+        gboolean start = false;
+        g_variant_get(params, "(b)", &start);
+        LOG("Logind: " << (start ? "Going to sleep" : "Resumed"));
+        if (prepareForSleepCallback)
+        {
+            prepareForSleepCallback(start);
+        }
+    }
+
+    // onPrepareForSleep is called with true before the system goes to sleep and with false after it has resumed
+    inline void Init(std::function<void(bool)>&& onPrepareForSleep)
+    {
+        prepareForSleepCallback = std::move(onPrepareForSleep);
+        prepareForSleepID = DBus::Subscribe(DBus::Bus::System, "org.freedesktop.login1", "org.freedesktop.login1.Manager", "PrepareForSleep",
+                                            "/org/freedesktop/login1", PrepareForSleep);
+    }
+
+    // fallbackCommand is run, if logind refuses or isn't there.
+    inline void CallManager(const char* method, const std::string& fallbackCommand)
+    {
+        // interactive = true, so polkit may ask for authentication
+        DBus::CallVoid(DBus::Bus::System, "org.freedesktop.login1", "/org/freedesktop/login1", "org.freedesktop.login1.Manager", method,
+                       g_variant_new("(b)", true),
+                       [fallbackCommand](bool success)
+                       {
+                           if (!success && !fallbackCommand.empty())
+                           {
+                               LOG("Logind: Falling back to " << fallbackCommand);
+                               system(fallbackCommand.c_str());
+                           }
+                       });
+    }
+
+    inline void PowerOff()
+    {
+        CallManager("PowerOff", "shutdown 0");
+    }
+
+    inline void Reboot()
+    {
+        CallManager("Reboot", "reboot");
+    }
+
+    inline void Suspend()
+    {
+        CallManager("Suspend", "");
+    }
+
+    inline void Shutdown()
+    {
+        DBus::Unsubscribe(prepareForSleepID);
+        prepareForSleepCallback = {};
+    }
+}
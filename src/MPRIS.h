@@ -0,0 +1,284 @@
+#pragma once
+#include "System.h"
+#include "Common.h"
+#include "DBus.h"
+
+#include <gio/gio.h>
+#include <cstring>
+#include <map>
+
+// Tracks all org.mpris.MediaPlayer2.* players on the session bus. Players are found through NameOwnerChanged and their state is
+// maintained from their PropertiesChanged signals, so reading the current track never causes d-bus traffic.
+namespace MPRIS
+{
+    constexpr const char* namePrefix = "org.mpris.MediaPlayer2.";
+
+    struct Player
+    {
+        std::string owner;
+        bool playing = false;
+        std::string title;
+        std::string artist;
+        std::string artUrl;
+        // When it started playing the last time, used to choose the player to show
+        uint64_t lastPlayed = 0;
+        DBus::SubscriptionID propertiesChangedID = 0;
+    };
+
+    // Keyed by well-known name
+    static std::map<std::string, Player> players;
+    static uint64_t playCounter = 0;
+
+    static System::MediaInfo info;
+    static bool dirty = true;
+
+    static DBus::SubscriptionID nameOwnerChangedID = 0;
+
+    inline void ApplyMetadata(Player& player, GVariant* metadata)
+    {
+        player.title.clear();
+        player.artist.clear();
+        player.artUrl.clear();
+
+        GVariantIter iter;
+        g_variant_iter_init(&iter, metadata);
+        const char* key = nullptr;
+        GVariant* value = nullptr;
+        while (g_variant_iter_next(&iter, "{&sv}", &key, &value))
+        {
+            if (strcmp(key, "xesam:title") == 0 && g_variant_is_of_type(value, G_VARIANT_TYPE_STRING))
+            {
+                player.title = g_variant_get_string(value, nullptr);
+            }
+            else if (strcmp(key, "xesam:artist") == 0 && g_variant_is_of_type(value, G_VARIANT_TYPE_STRING_ARRAY))
+            {
+                // Multiple artists are joined
+                GVariantIter artistIter;
+                g_variant_iter_init(&artistIter, value);
+                const char* artist = nullptr;
+                while (g_variant_iter_next(&artistIter, "&s", &artist))
+                {
+                    if (player.artist.size())
+                        player.artist += ", ";
+                    player.artist += artist;
+                }
+            }
+            else if (strcmp(key, "mpris:artUrl") == 0 && g_variant_is_of_type(value, G_VARIANT_TYPE_STRING))
+            {
+                player.artUrl = g_variant_get_string(value, nullptr);
+            }
+            g_variant_unref(value);
+        }
+    }
+
+    // properties is of type a{sv}
+    inline void ApplyProperties(Player& player, GVariantIter* properties)
+    {
+        const char* key = nullptr;
+        GVariant* value = nullptr;
+        while (g_variant_iter_next(properties, "{&sv}", &key, &value))
+        {
+            if (strcmp(key, "PlaybackStatus") == 0 && g_variant_is_of_type(value, G_VARIANT_TYPE_STRING))
+            {
+                bool playing = strcmp(g_variant_get_string(value, nullptr), "Playing") == 0;
+                if (playing && !player.playing)
+                {
+                    player.lastPlayed = ++playCounter;
+                }
+                player.playing = playing;
+            }
+            else if (strcmp(key, "Metadata") == 0)
+            {
+                ApplyMetadata(player, value);
+            }
+            g_variant_unref(value);
+        }
+        dirty = true;
+    }
+
+    inline void RemovePlayer(const std::string& name)
+    {
+        auto it = players.find(name);
+        if (it == players.end())
+        {
+            return;
+        }
+        LOG("MPRIS: Removing " << name);
+        DBus::Unsubscribe(it->second.propertiesChangedID);
+        players.erase(it);
+        dirty = true;
+    }
+
+    inline void AddPlayer(const std::string& name, const std::string& owner)
+    {
+        RemovePlayer(name);
+        LOG("MPRIS: Adding " << name);
+
+        Player& player = players[name];
+        player.owner = owner;
+        // Signals are sent from the unique name
+        player.propertiesChangedID = DBus::Subscribe(DBus::Bus::Session, owner.c_str(), "org.freedesktop.DBus.Properties", "PropertiesChanged",
+                                                     "/org/mpris/MediaPlayer2",
+                                                     [name](const char*, const char*, const char*, const char*, GVariant* params)
+                                                     {
+                                                         auto it = players.find(name);
+                                                         if (it == players.end())
+                                                         {
+                                                             return;
+                                                         }
+                                                         const char* interface = nullptr;
+                                                         GVariantIter* properties = nullptr;
+                                                         g_variant_get(params, "(&sa{sv}as)", &interface, &properties, nullptr);
+                                                         if (strcmp(interface, "org.mpris.MediaPlayer2.Player") == 0)
+                                                         {
+                                                             ApplyProperties(it->second, properties);
+                                                         }
+                                                         g_variant_iter_free(properties);
+                                                     });
+
+        DBus::Call(DBus::Bus::Session, name.c_str(), "/org/mpris/MediaPlayer2", "org.freedesktop.DBus.Properties", "GetAll",
+                   g_variant_new("(s)", "org.mpris.MediaPlayer2.Player"), G_VARIANT_TYPE("(a{sv})"),
+                   [name](GVariant* reply)
+                   {
+                       auto it = players.find(name);
+                       if (!reply || it == players.end())
+                       {
+                           return;
+                       }
+                       GVariantIter* properties = nullptr;
+                       g_variant_get(reply, "(a{sv})", &properties);
+                       ApplyProperties(it->second, properties);
+                       g_variant_iter_free(properties);
+                   });
+    }
+
+    inline void NameOwnerChanged(const char*, const char*, const char*, const char*, GVariant* params)
+    {
+        const char* name = nullptr;
+        const char* oldOwner = nullptr;
+        const char* newOwner = nullptr;
+        g_variant_get(params, "(&s&s&s)", &name, &oldOwner, &newOwner);
+        if (strncmp(name, namePrefix, strlen(namePrefix)) != 0)
+        {
+            return;
+        }
+        if (strlen(newOwner) == 0)
+        {
+            RemovePlayer(name);
+        }
+        else
+        {
+            AddPlayer(name, newOwner);
+        }
+    }
+
+    inline void Init()
+    {
+        if (!DBus::Get(DBus::Bus::Session))
+        {
+            return;
+        }
+        nameOwnerChangedID = DBus::Subscribe(DBus::Bus::Session, "org.freedesktop.DBus", "org.freedesktop.DBus", "NameOwnerChanged", nullptr,
+                                             NameOwnerChanged);
+
+        // Players, which were there before us
+        DBus::Call(DBus::Bus::Session, "org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus", "ListNames", nullptr,
+                   G_VARIANT_TYPE("(as)"),
+                   [](GVariant* reply)
+                   {
+                       if (!reply)
+                       {
+                           return;
+                       }
+                       GVariantIter* names = nullptr;
+                       g_variant_get(reply, "(as)", &names);
+                       const char* name = nullptr;
+                       while (g_variant_iter_next(names, "&s", &name))
+                       {
+                           if (strncmp(name, namePrefix, strlen(namePrefix)) != 0)
+                           {
+                               continue;
+                           }
+                           std::string nameStr = name;
+                           DBus::Call(DBus::Bus::Session, "org.freedesktop.DBus", "/org/freedesktop/DBus", "org.freedesktop.DBus", "GetNameOwner",
+                                      g_variant_new("(s)", name), G_VARIANT_TYPE("(s)"),
+                                      [nameStr](GVariant* reply)
+                                      {
+                                          if (!reply || players.count(nameStr))
+                                          {
+                                              return;
+                                          }
+                                          const char* owner = nullptr;
+                                          g_variant_get(reply, "(&s)", &owner);
+                                          AddPlayer(nameStr, owner);
+                                      });
+                       }
+                       g_variant_iter_free(names);
+                   });
+    }
+
+    // The player to show and control: The last one that started playing, or if none is playing the last one that played.
+    inline const std::string* GetActivePlayerName()
+    {
+        const std::string* active = nullptr;
+        const Player* activePlayer = nullptr;
+        for (auto& [name, player] : players)
+        {
+            if (!activePlayer || (player.playing && !activePlayer->playing) ||
+                (player.playing == activePlayer->playing && player.lastPlayed > activePlayer->lastPlayed))
+            {
+                active = &name;
+                activePlayer = &player;
+            }
+        }
+        return active;
+    }
+
+    inline const System::MediaInfo& GetInfo()
+    {
+        if (!dirty)
+        {
+            return info;
+        }
+        dirty = false;
+
+        const std::string* active = GetActivePlayerName();
+        if (active)
+        {
+            const Player& player = players[*active];
+            info.player = active->substr(strlen(namePrefix));
+            info.playing = player.playing;
+            info.title = player.title;
+            info.artist = player.artist;
+            info.artUrl = player.artUrl;
+        }
+        else
+        {
+            uint32_t revision = info.revision;
+            info = {};
+            info.revision = revision;
+        }
+        info.revision++;
+        return info;
+    }
+
+    inline void CallPlayer(const char* method)
+    {
+        const std::string* active = GetActivePlayerName();
+        if (!active)
+        {
+            return;
+        }
+        DBus::CallVoid(DBus::Bus::Session, active->c_str(), "/org/mpris/MediaPlayer2", "org.mpris.MediaPlayer2.Player", method, nullptr);
+    }
+
+    inline void Shutdown()
+    {
+        DBus::Unsubscribe(nameOwnerChangedID);
+        for (auto& [name, player] : players)
+        {
+            DBus::Unsubscribe(player.propertiesChangedID);
+        }
+        players.clear();
+    }
+}
@@ -20,6 +20,22 @@ namespace PulseAudio
     static bool queueUpdate = false;
     static bool blockUpdate = false;
 
+    static std::vector<System::AudioRecorder> sourceOutputs;
+    static uint32_t sourceOutputsRevision = 0;
+
+    static std::vector<System::AudioStream> sinkInputs;
+    static uint32_t sinkInputsRevision = 0;
+
+    // Only one volume operation per sink input is in flight. Values requested meanwhile are coalesced into the next operation.
+    struct SinkInputVolumeRequest
+    {
+        uint8_t channels = 0;
+        bool inFlight = false;
+        bool pending = false;
+        double volume = 0;
+    };
+    static std::unordered_map<uint32_t, SinkInputVolumeRequest> sinkInputRequests;
+
     inline void FlushLoop()
     {
         while (pendingOperations.size() > 0)
@@ -140,6 +156,229 @@ namespace PulseAudio
         FlushLoop();
     }
 
+    inline void SourceOutputInfoCallback(pa_context*, const pa_source_output_info* paInfo, int, void*)
+    {
+        if (!paInfo)
+            return;
+
+        System::AudioRecorder recorder;
+        recorder.index = paInfo->index;
+        recorder.corked = paInfo->corked;
+
+        const char* appName = pa_proplist_gets(paInfo->proplist, PA_PROP_APPLICATION_NAME);
+        recorder.appName = appName ? appName : paInfo->name;
+        const char* icon = pa_proplist_gets(paInfo->proplist, PA_PROP_APPLICATION_ICON_NAME);
+        recorder.icon = icon ? icon : "";
+
+        auto it = std::find_if(sourceOutputs.begin(), sourceOutputs.end(),
+                               [&](const System::AudioRecorder& other)
+                               {
+                                   return other.index == recorder.index;
+                               });
+        if (it != sourceOutputs.end())
+        {
+            if (it->appName == recorder.appName && it->icon == recorder.icon && it->corked == recorder.corked)
+            {
+                // Nothing we care about changed
+                return;
+            }
+            *it = std::move(recorder);
+        }
+        else
+        {
+            LOG("PulseAudio: " << recorder.appName << " started recording");
+            sourceOutputs.push_back(std::move(recorder));
+        }
+        sourceOutputsRevision++;
+    }
+
+    inline void OnSourceOutputEvent(uint32_t event, uint32_t idx)
+    {
+        switch (event)
+        {
+        case PA_SUBSCRIPTION_EVENT_NEW:
+        case PA_SUBSCRIPTION_EVENT_CHANGE:
+        {
+            // Only query the single output that changed. The result is dispatched in a later iteration.
+            pa_operation* op = pa_context_get_source_output_info(context, idx, SourceOutputInfoCallback, nullptr);
+            pa_operation_unref(op);
+            break;
+        }
+        case PA_SUBSCRIPTION_EVENT_REMOVE:
+            sourceOutputs.erase(std::remove_if(sourceOutputs.begin(), sourceOutputs.end(),
+                                               [&](const System::AudioRecorder& recorder)
+                                               {
+                                                   return recorder.index == idx;
+                                               }),
+                                sourceOutputs.end());
+            sourceOutputsRevision++;
+            break;
+        }
+    }
+
+    inline void SinkInputInfoCallback(pa_context*, const pa_sink_input_info* paInfo, int, void*)
+    {
+        if (!paInfo)
+            return;
+
+        SinkInputVolumeRequest& request = sinkInputRequests[paInfo->index];
+        request.channels = paInfo->volume.channels;
+
+        auto it = std::find_if(sinkInputs.begin(), sinkInputs.end(),
+                               [&](const System::AudioStream& stream)
+                               {
+                                   return stream.index == paInfo->index;
+                               });
+        if (it == sinkInputs.end())
+        {
+            sinkInputs.push_back({});
+            it = sinkInputs.end() - 1;
+            it->index = paInfo->index;
+        }
+        System::AudioStream& stream = *it;
+
+        const char* appName = pa_proplist_gets(paInfo->proplist, PA_PROP_APPLICATION_NAME);
+        const char* icon = pa_proplist_gets(paInfo->proplist, PA_PROP_APPLICATION_ICON_NAME);
+        std::string newAppName = appName ? appName : paInfo->name;
+        std::string newIcon = icon ? icon : "";
+        // Don't let the server echo older volumes back, while we're still changing it.
+        double newVolume = (request.inFlight || request.pending) ? stream.volume : PAVolumeToDouble(&paInfo->volume);
+        bool newMuted = paInfo->mute;
+
+        if (stream.revision != 0 && stream.appName == newAppName && stream.icon == newIcon && stream.volume == newVolume &&
+            stream.muted == newMuted)
+        {
+            // Nothing we care about changed
+            return;
+        }
+        stream.appName = std::move(newAppName);
+        stream.icon = std::move(newIcon);
+        stream.volume = newVolume;
+        stream.muted = newMuted;
+        stream.revision = ++sinkInputsRevision;
+    }
+
+    inline void OnSinkInputEvent(uint32_t event, uint32_t idx)
+    {
+        switch (event)
+        {
+        case PA_SUBSCRIPTION_EVENT_NEW:
+        case PA_SUBSCRIPTION_EVENT_CHANGE:
+        {
+            pa_operation* op = pa_context_get_sink_input_info(context, idx, SinkInputInfoCallback, nullptr);
+            pa_operation_unref(op);
+            break;
+        }
+        case PA_SUBSCRIPTION_EVENT_REMOVE:
+            sinkInputs.erase(std::remove_if(sinkInputs.begin(), sinkInputs.end(),
+                                            [&](const System::AudioStream& stream)
+                                            {
+                                                return stream.index == idx;
+                                            }),
+                             sinkInputs.end());
+            sinkInputRequests.erase(idx);
+            sinkInputsRevision++;
+            break;
+        }
+    }
+
+    inline const std::vector<System::AudioStream>& GetSinkInputs(uint32_t& revision)
+    {
+        pa_mainloop_iterate(mainLoop, 0, nullptr);
+        revision = sinkInputsRevision;
+        return sinkInputs;
+    }
+
+    // Only queues the operation and doesn't iterate the loop, so it can be called from anywhere, including PulseAudio callbacks
+    inline void IssueSinkInputVolume(uint32_t index, SinkInputVolumeRequest& request)
+    {
+        pa_cvolume volume;
+        pa_cvolume_set(&volume, request.channels, (pa_volume_t)(request.volume * PA_VOLUME_NORM));
+
+        auto onFinish = [](pa_context*, int success, void* data)
+        {
+            uint32_t index = (uint32_t)(uintptr_t)data;
+            if (!success)
+            {
+                LOG("PulseAudio: Failed to set volume of sink input " << index);
+            }
+            auto it = sinkInputRequests.find(index);
+            if (it == sinkInputRequests.end())
+            {
+                // Stream has vanished in the meantime
+                return;
+            }
+            it->second.inFlight = false;
+            if (it->second.pending)
+            {
+                IssueSinkInputVolume(index, it->second);
+            }
+        };
+        pa_operation* op = pa_context_set_sink_input_volume(context, index, &volume, +onFinish, (void*)(uintptr_t)index);
+        if (!op)
+        {
+            LOG("PulseAudio: pa_context_set_sink_input_volume failed!");
+            request.inFlight = false;
+            request.pending = false;
+            return;
+        }
+        pa_operation_unref(op);
+        request.inFlight = true;
+        request.pending = false;
+    }
+
+    inline void SetVolumeSinkInput(uint32_t index, double value)
+    {
+        auto it = sinkInputRequests.find(index);
+        if (it == sinkInputRequests.end() || it->second.channels == 0)
+        {
+            LOG("PulseAudio: Unknown sink input " << index);
+            return;
+        }
+        SinkInputVolumeRequest& request = it->second;
+        request.volume = std::clamp(value, 0., 1.);
+
+        // Reflect it right away, so the UI doesn't jump back
+        for (auto& stream : sinkInputs)
+        {
+            if (stream.index == index && stream.volume != request.volume)
+            {
+                stream.volume = request.volume;
+                stream.revision = ++sinkInputsRevision;
+            }
+        }
+
+        if (request.inFlight)
+        {
+            // Will be sent, when the current operation has finished
+            request.pending = true;
+        }
+        else
+        {
+            IssueSinkInputVolume(index, request);
+        }
+        // Send it now (or finish the previous one), instead of waiting for the next poll
+        pa_mainloop_iterate(mainLoop, 0, nullptr);
+    }
+
+    inline void SetMutedSinkInput(uint32_t index, bool muted)
+    {
+        LOG("Audio: Set mute of sink input " << index << ": " << muted);
+        pa_operation* op = pa_context_set_sink_input_mute(context, index, muted, nullptr, nullptr);
+        if (op)
+        {
+            pa_operation_unref(op);
+        }
+        pa_mainloop_iterate(mainLoop, 0, nullptr);
+    }
+
+    inline const std::vector<System::AudioRecorder>& GetSourceOutputs(uint32_t& revision)
+    {
+        pa_mainloop_iterate(mainLoop, 0, nullptr);
+        revision = sourceOutputsRevision;
+        return sourceOutputs;
+    }
+
     inline System::AudioInfo GetInfo()
     {
         pa_mainloop_iterate(mainLoop, 0, nullptr);
@@ -191,14 +430,25 @@ namespace PulseAudio
         {
             ASSERT(success >= 0, "Failed to subscribe to pulseaudio");
         };
-        pa_operation* op = pa_context_subscribe(context, (pa_subscription_mask_t)(PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SOURCE),
-                                                +subscribeSuccess, nullptr);
+        auto mask = PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SOURCE | PA_SUBSCRIPTION_MASK_SOURCE_OUTPUT | PA_SUBSCRIPTION_MASK_SINK_INPUT;
+        pa_operation* op = pa_context_subscribe(context, (pa_subscription_mask_t)mask, +subscribeSuccess, nullptr);
         pa_operation_ref(op);
         pendingOperations.push_back(op);
         FlushLoop();
 
-        auto subscribeCallback = [](pa_context*, pa_subscription_event_type_t type, uint32_t, void*)
+        auto subscribeCallback = [](pa_context*, pa_subscription_event_type_t type, uint32_t idx, void*)
         {
+            uint32_t facility = type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+            if (facility == PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT)
+            {
+                OnSourceOutputEvent(type & PA_SUBSCRIPTION_EVENT_TYPE_MASK, idx);
+                return;
+            }
+            if (facility == PA_SUBSCRIPTION_EVENT_SINK_INPUT)
+            {
+                OnSinkInputEvent(type & PA_SUBSCRIPTION_EVENT_TYPE_MASK, idx);
+                return;
+            }
             if (type == PA_SUBSCRIPTION_EVENT_CHANGE)
                 queueUpdate = true;
         };
@@ -207,6 +457,15 @@ namespace PulseAudio
         // Initialise info
         UpdateInfo();
 
+        // Fetch the already running recorders once, the events keep it up to date afterwards.
+        op = pa_context_get_source_output_info_list(context, SourceOutputInfoCallback, nullptr);
+        pa_operation_ref(op);
+        pendingOperations.push_back(op);
+        op = pa_context_get_sink_input_info_list(context, SinkInputInfoCallback, nullptr);
+        pa_operation_ref(op);
+        pendingOperations.push_back(op);
+        FlushLoop();
+
         ASSERT(res >= 0, "pa_context_connect failed!");
     }
 
@@ -3,6 +3,9 @@
 #include "Widget.h"
 #include "Config.h"
 #include "Common.h"
+#include "DBus.h"
+#include "IconTheme.h"
+#include "Image.h"
 
 #ifdef WITH_SNI
 
@@ -11,12 +14,14 @@
 #include <gio/gio.h>
 #include <libdbusmenu-gtk/menu.h>
 
-#define STB_IMAGE_IMPLEMENTATION
+// Implementation is in Image.cpp
 #include <stb/stb_image.h>
 
 #include <fstream>
 #include <cstdio>
-#include <unordered_set>
+#include <cmath>
+#include <map>
+#include <memory>
 
 namespace SNI
 {
@@ -30,155 +35,277 @@ namespace SNI
     {
         std::string name;
         std::string object;
-        size_t w = 0;
-        size_t h = 0;
-        uint8_t* iconData = nullptr;
+        // RGBA32, owned by the item
+        GdkPixbuf* icon = nullptr;
+        // icon prescaled for surfaceSize and surfaceScale, owned by the item
+        cairo_surface_t* surface = nullptr;
+        int surfaceSize = 0;
+        int surfaceScale = 0;
+        // Path of a symbolic svg icon, rendered again when the color of the tray changes. Empty for other icons.
+        std::string symbolicPath;
 
         std::string tooltip = "";
 
         std::string menuObjectPath = "";
+        // Created on first hover or click and kept with the widget, dbusmenu updates it from the layout signals of the item
+        GtkMenu* menu = nullptr;
 
+        // Widgets of the item, null while it isn't shown
         EventBox* gtkEvent = nullptr;
+        Texture* texture = nullptr;
+        // What the widgets were created with, so an update knows whether they can be kept
+        int widgetSize = 0;
+        int widgetPadding = 0;
+
+        // Refresh flags of the signals, which arrived since the last flush
+        uint32_t pendingRefresh = 0;
 
         int watcherID = -1;
-        int propertyChangeWatcherID = -1;
     };
-    std::vector<Item> items;
+    // Keyed by name. Ordered, so icons don't jump around, and addresses are stable for the click handlers.
+    std::map<std::string, Item> items;
+
+    // Items registered by well-known name send their signals from their unique name
+    std::unordered_map<std::string, std::string> nameOwners;
+    // One match rule for the signals of all items
+    DBus::SubscriptionID itemSignalsID = 0;
 
-    std::unordered_map<std::string, Item> clientsToQuery;
-    std::unordered_set<std::string> reloadedNames;
+    // Scheduled by the first signal, so all signals of one main loop iteration result in one refresh per item
+    guint refreshSourceID = 0;
 
     // Gtk stuff, TODO: Allow more than one instance
-    // Simply removing the gtk_drawing_areas doesn't trigger proper redrawing
-    //   HACK: Make an outer permanent and an inner box, which will be deleted and readded
-    Widget* parentBox;
-    Widget* iconBox;
+    // Both boxes are permanent, only the widgets of the items, which changed, are added, removed or updated
+    Widget* parentBox = nullptr;
+    Box* iconBox = nullptr;
+
+    // Items, whose properties are being fetched. Keyed by name, the value identifies the newest query, so outdated replies are dropped.
+    std::unordered_map<std::string, uint64_t> pendingQueries;
+    uint64_t curQueryID = 0;
+    // A client, which doesn't answer in time, only loses its own icon
+    constexpr int32_t itemQueryTimeoutMS = 2000;
+
+    // Size of the icon in the bar, as configured by SNIIconSize
+    static int GetIconSize(const std::string& tooltip)
+    {
+        bool wasExplicitOverride = false;
+        int size = 24;
+        for (auto& [filter, iconSize] : Config::Get().sniIconSizes)
+        {
+            if (tooltip.find(filter) != std::string::npos)
+            {
+                wasExplicitOverride = true;
+                size = iconSize;
+            }
+            else if (filter == "*" && !wasExplicitOverride)
+            {
+                size = iconSize;
+            }
+        }
+        return size;
+    }
 
-    static Item CreateItem(std::string&& name, std::string&& object)
+    static int GetScaleFactor()
     {
-        Item item{};
-        item.name = name;
-        item.object = object;
-        auto getProperty = [&](const char* prop) -> GVariant*
-        {
-            GError* err = nullptr;
-            GVariant* params[2];
-            params[0] = g_variant_new_string("org.kde.StatusNotifierItem");
-            params[1] = g_variant_new_string(prop);
-            GVariant* param = g_variant_new_tuple(params, 2);
-            GVariant* res = g_dbus_connection_call_sync(dbusConnection, name.c_str(), object.c_str(), "org.freedesktop.DBus.Properties", "Get", param,
-                                                        G_VARIANT_TYPE("(v)"), G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &err);
-            if (err)
+        if (parentBox && parentBox->Get())
+        {
+            return gtk_widget_get_scale_factor(parentBox->Get());
+        }
+        return 1;
+    }
+
+    // Color, which the symbolic icons were last updated to
+    static uint32_t symbolicColor = 0xffffff;
+
+    // CSS color of the tray as 0xRRGGBB, symbolic icons are drawn with it
+    static uint32_t GetForegroundColor()
+    {
+        if (!iconBox || !iconBox->Get())
+        {
+            return 0xffffff;
+        }
+        GdkRGBA color;
+        gtk_style_context_get_color(gtk_widget_get_style_context(iconBox->Get()), GTK_STATE_FLAG_NORMAL, &color);
+        auto channel = [](double value)
+        {
+            return (uint32_t)std::clamp((int)std::round(value * 255), 0, 255);
+        };
+        return channel(color.red) << 16 | channel(color.green) << 8 | channel(color.blue);
+    }
+
+    static void FreeIcon(Item& item)
+    {
+        if (item.icon)
+            g_object_unref(item.icon);
+        if (item.surface)
+            cairo_surface_destroy(item.surface);
+        item.icon = nullptr;
+        item.surface = nullptr;
+    }
+
+    static void FreeMenu(Item& item)
+    {
+        if (item.menu)
+        {
+            gtk_widget_destroy((GtkWidget*)item.menu);
+            g_object_unref(item.menu);
+            item.menu = nullptr;
+        }
+    }
+
+    // The icon scaled once with a good filter to size x size at the given scale, so drawing only has to paint it.
+    static cairo_surface_t* GetSurface(Item& item, int size, int scale)
+    {
+        if (item.surface && item.surfaceSize == size && item.surfaceScale == scale)
+        {
+            return item.surface;
+        }
+        if (item.surface)
+        {
+            cairo_surface_destroy(item.surface);
+        }
+
+        int pixels = size * scale;
+        int width = gdk_pixbuf_get_width(item.icon);
+        int height = gdk_pixbuf_get_height(item.icon);
+        // Keep the aspect ratio and center non square icons
+        double factor = (double)pixels / std::max(width, height);
+        item.surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, pixels, pixels);
+        cairo_t* cr = cairo_create(item.surface);
+        cairo_translate(cr, (pixels - width * factor) / 2, (pixels - height * factor) / 2);
+        cairo_scale(cr, factor, factor);
+        gdk_cairo_set_source_pixbuf(cr, item.icon, 0, 0);
+        cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_BEST);
+        cairo_paint(cr);
+        cairo_destroy(cr);
+        item.surfaceSize = size;
+        item.surfaceScale = scale;
+        LOG("SNI: Scaled " << item.name << " from " << width << "x" << height << " to " << pixels);
+        return item.surface;
+    }
+
+    // properties is an a{sv} with the ToolTip property
+    static void LoadToolTip(Item& item, GVariant* properties)
+    {
+        GVariant* tooltipVar = g_variant_lookup_value(properties, "ToolTip", nullptr);
+        if (tooltipVar)
+        {
+            const gchar* title = nullptr;
+            if (g_variant_is_container(tooltipVar) && g_variant_n_children(tooltipVar) >= 4)
+            {
+                // According to spec, ToolTip is of type (sa(iiab)ss) => 4 children
+                // Most icons only set the "title" component (e.g. Discord, KeePassXC, ...)
+                g_variant_get_child(tooltipVar, 2, "s", &title);
+            }
+            else
+            {
+                // TeamViewer only exposes a string, which is not according to spec!
+                title = g_variant_get_string(tooltipVar, nullptr);
+            }
+
+            if (title != nullptr)
             {
-                g_error_free(err);
-                return nullptr;
+                item.tooltip = title;
             }
-            // There's probably a better method than to use 3 variants
-            // g_variant_unref(params[0]);
-            // g_variant_unref(params[1]);
-            // g_variant_unref(param);
-            return res;
+            else
+            {
+                LOG("SNI: Error querying tooltip");
+            }
+            LOG("SNI: Title: " << item.tooltip);
+            g_variant_unref(tooltipVar);
+        }
+    }
+
+    // properties is an a{sv} with the IconPixmap, IconName and IconThemePath properties. The size of the icon depends on the tooltip.
+    static void LoadIcon(Item& item, GVariant* properties)
+    {
+        const std::string& name = item.name;
+        auto getProperty = [&](const char* prop, const GVariantType* type) -> GVariant*
+        {
+            return g_variant_lookup_value(properties, prop, type);
         };
 
         bool hasPixmap = false;
-        GVariant* iconPixmap = getProperty("IconPixmap");
-        if (iconPixmap)
+        GVariant* arr = getProperty("IconPixmap", G_VARIANT_TYPE("a(iiay)"));
+        if (arr)
         {
-            // Only get first item
-            GVariant* arr = nullptr;
-            g_variant_get(iconPixmap, "(v)", &arr);
-
+            // Items may send multiple resolutions. Take the smallest one, which isn't smaller than the icon in the bar, or else the largest.
+            int target = GetIconSize(item.tooltip) * GetScaleFactor();
+            int width = 0;
+            int height = 0;
+            GVariant* data = nullptr;
             GVariantIter* arrIter = nullptr;
             g_variant_get(arr, "a(iiay)", &arrIter);
-
-            if (g_variant_iter_n_children(arrIter) != 0)
+            int curWidth;
+            int curHeight;
+            GVariant* curData = nullptr;
+            while (g_variant_iter_next(arrIter, "(ii@ay)", &curWidth, &curHeight, &curData))
             {
-                int width;
-                int height;
-                GVariantIter* data = nullptr;
-                g_variant_iter_next(arrIter, "(iiay)", &width, &height, &data);
+                int curSize = std::max(curWidth, curHeight);
+                int bestSize = std::max(width, height);
+                bool better = !data || (curSize >= target && (bestSize < target || curSize < bestSize)) || (bestSize < target && curSize > bestSize);
+                if (better)
+                {
+                    if (data)
+                        g_variant_unref(data);
+                    width = curWidth;
+                    height = curHeight;
+                    data = curData;
+                }
+                else
+                {
+                    g_variant_unref(curData);
+                }
+            }
 
+            if (data)
+            {
                 LOG("SNI: Width: " << width);
                 LOG("SNI: Height: " << height);
-                item.w = width;
-                item.h = height;
-                item.iconData = new uint8_t[width * height * 4];
-
-                uint8_t px = 0;
-                int i = 0;
-                while (g_variant_iter_next(data, "y", &px))
+                // Read the bytes in place instead of iterating them
+                gsize numBytes = 0;
+                const uint8_t* argb = (const uint8_t*)g_variant_get_fixed_array(data, &numBytes, 1);
+                if (width > 0 && height > 0 && numBytes == (gsize)width * height * 4)
                 {
-                    item.iconData[i] = px;
-                    i++;
+                    // Converted straight into the buffer the pixbuf owns
+                    uint8_t* rgba = (uint8_t*)g_malloc(numBytes);
+                    Image::ARGBToRGBA(argb, rgba, (size_t)width * height);
+                    item.icon = gdk_pixbuf_new_from_data(
+                        rgba, GDK_COLORSPACE_RGB, true, 8, width, height, width * 4,
+                        [](guchar* buf, void*)
+                        {
+                            g_free(buf);
+                        },
+                        nullptr);
+                    item.symbolicPath.clear();
+                    hasPixmap = true;
                 }
-                for (int i = 0; i < width * height; i++)
+                else
                 {
-                    struct Px
-                    {
-                        // This should be bgra...
-                        // Since source is ARGB32 in network order(=big-endian)
-                        // and x86 Linux is little-endian, we *should* swap b and r...
-                        uint8_t a, r, g, b;
-                    };
-                    Px& pixel = ((Px*)item.iconData)[i];
-                    // Swap to create rgba
-                    pixel = {pixel.r, pixel.g, pixel.b, pixel.a};
+                    LOG("SNI: Pixmap of " << name << " has " << numBytes << " bytes, expected " << width * height * 4);
                 }
 
-                g_variant_iter_free(data);
-
-                hasPixmap = true;
+                g_variant_unref(data);
             }
             g_variant_iter_free(arrIter);
             g_variant_unref(arr);
-            g_variant_unref(iconPixmap);
         }
 
         // Pixmap querying has failed, try IconName
         if (!hasPixmap)
         {
-            auto findIconWithoutPath = [](const char* iconName) -> std::string
+            // Only used, if the icon isn't in IconThemePath. e.g. network-manager-applet relies on this
+            auto findIconWithoutPath = [&](const char* iconName) -> std::string
             {
-                std::string iconPath;
-                const char* dataDirs = getenv("XDG_DATA_DIRS");
-                // Nothing defined, look in $XDG_DATA_DIRS/icons
-                // network-manager-applet does this e.g.
-                if (dataDirs)
-                {
-                    for (auto& dataDir : Utils::Split(dataDirs, ':'))
-                    {
-                        LOG("SNI: Searching icon " << iconName << " in " << dataDir << "/icons");
-                        std::string path = Utils::FindFileWithName(dataDir + "/icons", iconName, ".png");
-                        if (path != "")
-                        {
-                            iconPath = path;
-                            break;
-                        }
-                    }
-                }
-                if (iconPath == "")
-                {
-                    // Fallback to /usr/share/icons
-                    LOG("SNI: Searching icon " << iconName << " in "
-                                               << "/usr/share/icons");
-                    iconPath = Utils::FindFileWithName("/usr/share/icons", iconName, ".png");
-                }
-                return iconPath;
+                return IconTheme::Lookup(iconName, GetIconSize(item.tooltip));
             };
 
             // Get icon theme path
-            GVariant* themePathVariant = getProperty("IconThemePath"); // Not defined by freedesktop, I think ayatana does this...
-            GVariant* iconNameVariant = getProperty("IconName");
+            GVariant* themePathStr = getProperty("IconThemePath", G_VARIANT_TYPE_STRING); // Not defined by freedesktop, I think ayatana does this...
+            GVariant* iconNameStr = getProperty("IconName", G_VARIANT_TYPE_STRING);
 
             std::string iconPath;
-            if (themePathVariant && iconNameVariant)
+            if (themePathStr && iconNameStr)
             {
-                // Why GLib?
-                GVariant* themePathStr = nullptr;
-                g_variant_get(themePathVariant, "(v)", &themePathStr);
-                GVariant* iconNameStr = nullptr;
-                g_variant_get(iconNameVariant, "(v)", &iconNameStr);
-
                 const char* themePath = g_variant_get_string(themePathStr, nullptr);
                 const char* iconName = g_variant_get_string(iconNameStr, nullptr);
                 if (strlen(themePath) == 0)
@@ -187,19 +314,18 @@ namespace SNI
                 }
                 else
                 {
-                    iconPath = std::string(themePath) + "/" + iconName + ".png"; // TODO: Find out if this is always png
+                    iconPath = std::string(themePath) + "/" + iconName + ".png";
+                    if (!g_file_test(iconPath.c_str(), G_FILE_TEST_EXISTS))
+                    {
+                        iconPath = std::string(themePath) + "/" + iconName + ".svg";
+                    }
                 }
 
-                g_variant_unref(themePathVariant);
                 g_variant_unref(themePathStr);
-                g_variant_unref(iconNameVariant);
                 g_variant_unref(iconNameStr);
             }
-            else if (iconNameVariant)
+            else if (iconNameStr)
             {
-                GVariant* iconNameStr = nullptr;
-                g_variant_get(iconNameVariant, "(v)", &iconNameStr);
-
                 const char* iconName = g_variant_get_string(iconNameStr, nullptr);
                 iconPath = findIconWithoutPath(iconName);
                 if (iconPath == "")
@@ -208,19 +334,37 @@ namespace SNI
                     iconPath = iconName;
                 }
 
-                g_variant_unref(iconNameVariant);
                 g_variant_unref(iconNameStr);
             }
+            else if (themePathStr)
+            {
+                g_variant_unref(themePathStr);
+                LOG("SNI: Unknown path!");
+                return;
+            }
             else
             {
                 LOG("SNI: Unknown path!");
-                return item;
+                return;
             }
 
             if (iconPath == "")
             {
                 LOG("SNI: Cannot find icon path for " << name);
-                return item;
+                return;
+            }
+
+            if (iconPath.size() > 4 && iconPath.compare(iconPath.size() - 4, 4, ".svg") == 0)
+            {
+                // Rendered at the exact size, so the surface doesn't need to be scaled
+                item.icon = IconTheme::LoadSVG(iconPath, GetIconSize(item.tooltip) * GetScaleFactor(), GetForegroundColor());
+                if (!item.icon)
+                {
+                    LOG("SNI: Cannot open " << iconPath);
+                    return;
+                }
+                item.symbolicPath = IconTheme::IsSymbolic(iconPath) ? iconPath : "";
+                return;
             }
 
             int width, height, channels;
@@ -228,282 +372,459 @@ namespace SNI
             if (!pixels)
             {
                 LOG("SNI: Cannot open " << iconPath);
-                return item;
+                return;
             }
-            item.w = width;
-            item.h = height;
-            item.iconData = new uint8_t[width * height * 4];
-            // Already rgba32
-            memcpy(item.iconData, pixels, width * height * 4);
-            stbi_image_free(pixels);
+            // Already rgba32, so the pixbuf can take the buffer
+            item.icon = gdk_pixbuf_new_from_data(
+                pixels, GDK_COLORSPACE_RGB, true, 8, width, height, width * 4,
+                [](guchar* buf, void*)
+                {
+                    stbi_image_free(buf);
+                },
+                nullptr);
+            item.symbolicPath.clear();
         }
+    }
 
-        // Query tooltip(Steam e.g. doesn't have one)
-        GVariant* tooltip = getProperty("ToolTip");
-        if (tooltip)
-        {
-            GVariant* tooltipVar;
-            g_variant_get_child(tooltip, 0, "v", &tooltipVar);
-            const gchar* title = nullptr;
-            if (g_variant_is_container(tooltipVar) && g_variant_n_children(tooltipVar) >= 4)
-            {
-                // According to spec, ToolTip is of type (sa(iiab)ss) => 4 children
-                // Most icons only set the "title" component (e.g. Discord, KeePassXC, ...)
-                g_variant_get_child(tooltipVar, 2, "s", &title);
-            }
-            else
-            {
-                // TeamViewer only exposes a string, which is not according to spec!
-                title = g_variant_get_string(tooltipVar, nullptr);
-            }
+    // properties is the a{sv} of Properties.GetAll
+    static Item CreateItem(const std::string& name, const std::string& object, GVariant* properties)
+    {
+        Item item{};
+        item.name = name;
+        item.object = object;
 
-            if (title != nullptr)
-            {
-                item.tooltip = title;
-            }
-            else
-            {
-                LOG("SNI: Error querying tooltip");
-            }
-            LOG("SNI: Title: " << item.tooltip);
-            g_variant_unref(tooltip);
-            g_variant_unref(tooltipVar);
-        }
+        // Query tooltip first, the icon size depends on it (Steam e.g. doesn't have one)
+        LoadToolTip(item, properties);
+        LoadIcon(item, properties);
 
         // Query menu
-        GVariant* menuPath = getProperty("Menu");
-        if (menuPath)
+        GVariant* menuVariant = g_variant_lookup_value(properties, "Menu", G_VARIANT_TYPE_OBJECT_PATH);
+        if (menuVariant)
         {
-            GVariant* menuVariant;
-            g_variant_get_child(menuPath, 0, "v", &menuVariant);
-            const char* objectPath;
-            g_variant_get(menuVariant, "o", &objectPath);
+            const char* objectPath = g_variant_get_string(menuVariant, nullptr);
             LOG("SNI: Menu object path: " << objectPath);
 
             item.menuObjectPath = objectPath;
 
             g_variant_unref(menuVariant);
-            g_variant_unref(menuPath);
         }
 
         return item;
     }
 
-    static void InvalidateWidget();
+    static void UpdateItemWidget(Item& item);
+    static void RemoveItemWidget(Item& item);
 
     static void DBusNameVanished(GDBusConnection*, const char* name, void*)
     {
-        auto it = std::find_if(items.begin(), items.end(),
-                               [&](const Item& item)
-                               {
-                                   return item.name == name;
-                               });
+        auto it = items.find(name);
         if (it != items.end())
         {
             LOG("SNI: " << name << " vanished!");
-            g_bus_unwatch_name(it->watcherID);
-            g_dbus_connection_signal_unsubscribe(dbusConnection, it->propertyChangeWatcherID);
+            g_bus_unwatch_name(it->second.watcherID);
+            nameOwners.erase(it->first);
+            pendingQueries.erase(it->first);
+            RemoveItemWidget(it->second);
+            FreeIcon(it->second);
             items.erase(it);
-            InvalidateWidget();
             return;
         }
 
-        auto toRegisterIt = clientsToQuery.find(name);
-        if (toRegisterIt != clientsToQuery.end())
-        {
-            clientsToQuery.erase(toRegisterIt);
-        }
+        // Drop the reply of a running query
+        pendingQueries.erase(name);
 
         LOG("SNI: Cannot remove unregistered bus name " << name);
         return;
     }
 
-    static void ItemPropertyChanged(GDBusConnection*, const char* senderName, const char* object, const char*, const char*, GVariant*, void* name)
+    static void DBusNameAppeared(GDBusConnection*, const char* name, const char* owner, void*)
+    {
+        nameOwners[name] = owner;
+    }
+
+    // Fetches all properties with one GetAll. Runs concurrently for all items, the widget is updated, when the reply arrives.
+    static void QueryItem(const std::string& name, const std::string& object)
     {
-        // I think the multiple calling of this callback is a symptom of not unsubscribing the ItemPropertyChanged callback. Since this is now done, I
-        // think the reloadedNames and object path checking is no longer needed. Since it doesn't do any harm (except being a little bit pointless)
-        // I'll leave the checks here for now.
-        // TODO: Investigate whether it is now actually fixed
+        uint64_t queryID = ++curQueryID;
+        pendingQueries[name] = queryID;
+        DBus::Call(DBus::Bus::Session, name.c_str(), object.c_str(), "org.freedesktop.DBus.Properties", "GetAll",
+                   g_variant_new("(s)", "org.kde.StatusNotifierItem"), G_VARIANT_TYPE("(a{sv})"),
+                   [name, object, queryID](GVariant* reply)
+                   {
+                       auto pendingIt = pendingQueries.find(name);
+                       if (pendingIt == pendingQueries.end() || pendingIt->second != queryID)
+                       {
+                           // Vanished or queried again in the meantime
+                           return;
+                       }
+                       pendingQueries.erase(pendingIt);
+                       if (!reply)
+                       {
+                           LOG("SNI: Cannot query " << name << " " << object);
+                           return;
+                       }
+
+                       LOG("SNI: Creating Item " << name << " " << object);
+                       GVariant* properties = g_variant_get_child_value(reply, 0);
+                       Item item = CreateItem(name, object, properties);
+                       g_variant_unref(properties);
+
+                       auto it = items.find(name);
+                       if (it != items.end())
+                       {
+                           // Reloaded, keep the watch and the widgets. The old icon is freed after the widget doesn't show it anymore.
+                           Item& existing = it->second;
+                           item.watcherID = existing.watcherID;
+                           item.gtkEvent = existing.gtkEvent;
+                           item.texture = existing.texture;
+                           item.widgetSize = existing.widgetSize;
+                           item.widgetPadding = existing.widgetPadding;
+                           if (item.menuObjectPath == existing.menuObjectPath)
+                           {
+                               item.menu = existing.menu;
+                               existing.menu = nullptr;
+                           }
+                           std::swap(existing, item);
+                           UpdateItemWidget(existing);
+                           FreeIcon(item);
+                           FreeMenu(item);
+                           return;
+                       }
+
+                       // Add handler for removing. Icon changes are handled by itemSignalsID.
+                       item.watcherID = g_bus_watch_name_on_connection(dbusConnection, item.name.c_str(), G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                                                       DBusNameAppeared, DBusNameVanished, nullptr, nullptr);
+                       UpdateItemWidget(items.emplace(name, std::move(item)).first->second);
+                   },
+                   itemQueryTimeoutMS);
+    }
+
+    // What a signal of an item says has changed
+    enum Refresh : uint32_t
+    {
+        RefreshIcon = 1 << 0,
+        RefreshToolTip = 1 << 1,
+    };
 
-        if (reloadedNames.insert(senderName).second == false)
+    // values is an a{sv} with the properties of refresh, which the item has
+    static void ApplyRefresh(const std::string& name, uint32_t refresh, GVariant* values)
+    {
+        auto it = items.find(name);
+        if (it == items.end())
         {
-            // senderName has already requested a change, ignore
-            LOG("SNI: " << senderName << " already signaled property change");
+            // Vanished in the meantime
             return;
         }
+        Item& item = it->second;
 
-        std::string nameStr = (const char*)name;
-        LOG("SNI: Reloading " << (const char*)name << " " << object << " (Sender: " << senderName << ")");
-
-        // We can't trust the object path given to us, since ItemPropertyChanged is called multiple times with the same name, but with different
-        // object paths.
-        auto it = std::find_if(items.begin(), items.end(),
-                               [&](const Item& item)
-                               {
-                                   return item.name == nameStr;
-                               });
-        std::string itemObjectPath;
-        if (it != items.end())
+        // Tooltip first, the icon size depends on it
+        if (refresh & RefreshToolTip)
         {
-            itemObjectPath = it->object;
+            LoadToolTip(item, values);
         }
-        else
+
+        // The old icon is shown, until the widget has the new one
+        GdkPixbuf* oldIcon = nullptr;
+        cairo_surface_t* oldSurface = nullptr;
+        if (refresh & RefreshIcon)
         {
-            // Item not already registered, fallback to provided name and hope the object path provided is accurate
-            LOG("SNI: Couldn't find name for actual object path!");
-            itemObjectPath = object;
+            oldIcon = item.icon;
+            oldSurface = item.surface;
+            item.icon = nullptr;
+            item.surface = nullptr;
+            LoadIcon(item, values);
+            if (!item.icon)
+            {
+                LOG("SNI: Keeping the old icon of " << name);
+                item.icon = oldIcon;
+                item.surface = oldSurface;
+                oldIcon = nullptr;
+                oldSurface = nullptr;
+            }
         }
 
-        // We don't care about *what* changed, just remove and reload
-        LOG("SNI: Actual object path: " << itemObjectPath)
-        if (it != items.end())
+        UpdateItemWidget(item);
+
+        if (oldIcon)
+            g_object_unref(oldIcon);
+        if (oldSurface)
+            cairo_surface_destroy(oldSurface);
+    }
+
+    // Fetches only the properties, which refresh refers to
+    static void RefreshItem(const std::string& name, const std::string& object, uint32_t refresh)
+    {
+        std::vector<std::string> properties;
+        if (refresh & RefreshToolTip)
         {
-            g_bus_unwatch_name(it->watcherID);
-            g_dbus_connection_signal_unsubscribe(dbusConnection, it->propertyChangeWatcherID);
-            items.erase(it);
+            properties.push_back("ToolTip");
         }
-        else
+        if (refresh & RefreshIcon)
         {
-            LOG("SNI: Coudn't remove item " << nameStr << " when reloading");
+            properties.push_back("IconPixmap");
+            properties.push_back("IconName");
+            properties.push_back("IconThemePath");
+        }
+
+        // The Gets run concurrently, the item is updated once with all replies
+        struct Fetch
+        {
+            GVariantDict values;
+            size_t remaining = 0;
+
+            ~Fetch() { g_variant_dict_clear(&values); }
+        };
+        auto fetch = std::make_shared<Fetch>();
+        g_variant_dict_init(&fetch->values, nullptr);
+        fetch->remaining = properties.size();
+        for (auto& property : properties)
+        {
+            DBus::Call(DBus::Bus::Session, name.c_str(), object.c_str(), "org.freedesktop.DBus.Properties", "Get",
+                       g_variant_new("(ss)", "org.kde.StatusNotifierItem", property.c_str()), G_VARIANT_TYPE("(v)"),
+                       [name, refresh, fetch, property](GVariant* reply)
+                       {
+                           if (reply)
+                           {
+                               // Missing properties (e.g. IconThemePath) are simply left out
+                               GVariant* value = nullptr;
+                               g_variant_get(reply, "(v)", &value);
+                               g_variant_dict_insert_value(&fetch->values, property.c_str(), value);
+                               g_variant_unref(value);
+                           }
+                           if (--fetch->remaining > 0)
+                           {
+                               return;
+                           }
+                           GVariant* values = g_variant_ref_sink(g_variant_dict_end(&fetch->values));
+                           ApplyRefresh(name, refresh, values);
+                           g_variant_unref(values);
+                       },
+                       itemQueryTimeoutMS);
         }
-        clientsToQuery[nameStr] = {nameStr, itemObjectPath};
     }
 
-    static TimerResult UpdateWidgets(Box&)
+    static gboolean FlushRefreshes(void*)
     {
-        // Flush connection, so we hopefully don't deadlock with any client
-        GError* err = nullptr;
-        g_dbus_connection_flush_sync(dbusConnection, nullptr, &err);
-        if (err)
+        refreshSourceID = 0;
+        for (auto& [name, item] : items)
         {
-            LOG("SNI: g_dbus_connection_call_sync failed: " << err->message);
-            g_error_free(err);
+            if (item.pendingRefresh)
+            {
+                LOG("SNI: Refreshing " << name << " " << item.object);
+                RefreshItem(name, item.object, item.pendingRefresh);
+                item.pendingRefresh = 0;
+            }
         }
+        return G_SOURCE_REMOVE;
+    }
 
-        if (RuntimeConfig::Get().hasSNI == false || Config::Get().enableSNI == false)
+    static void ItemSignal(const char* senderName, const char*, const char*, const char* signal, GVariant*)
+    {
+        uint32_t refresh = 0;
+        if (strcmp(signal, "NewIcon") == 0 || strcmp(signal, "NewIconThemePath") == 0)
         {
-            // Don't bother
-            return TimerResult::Delete;
-        }
-        for (auto& [name, client] : clientsToQuery)
-        {
-            LOG("SNI: Creating Item " << client.name << " " << client.object);
-            Item item = CreateItem(std::move(client.name), std::move(client.object));
-            // Add handler for removing
-            item.watcherID = g_bus_watch_name_on_connection(dbusConnection, item.name.c_str(), G_BUS_NAME_WATCHER_FLAGS_NONE, nullptr,
-                                                            DBusNameVanished, nullptr, nullptr);
-
-            // Add handler for icon change
-            char* staticBuf = new char[item.name.size() + 1]{0x0};
-            memcpy(staticBuf, item.name.c_str(), item.name.size());
-            LOG("SNI: Allocating static name buffer for " << item.name);
-            item.propertyChangeWatcherID = g_dbus_connection_signal_subscribe(
-                dbusConnection, item.name.c_str(), "org.kde.StatusNotifierItem", nullptr, nullptr, nullptr, G_DBUS_SIGNAL_FLAGS_NONE,
-                ItemPropertyChanged, staticBuf,
-                +[](void* ptr)
-                {
-                    LOG("SNI: Delete static name buffer for " << (char*)ptr);
-                    delete[] (char*)ptr;
-                });
+            refresh = RefreshIcon;
+        }
+        else if (strcmp(signal, "NewToolTip") == 0)
+        {
+            refresh = RefreshToolTip;
+        }
+        else
+        {
+            // NewStatus carries the new status, NewTitle, NewAttentionIcon and NewOverlayIcon refer to properties. None of them are shown.
+            return;
+        }
 
-            items.push_back(std::move(item));
+        auto it = items.find(senderName);
+        if (it == items.end())
+        {
+            it = std::find_if(items.begin(), items.end(),
+                              [&](const auto& entry)
+                              {
+                                  auto ownerIt = nameOwners.find(entry.first);
+                                  return ownerIt != nameOwners.end() && ownerIt->second == senderName;
+                              });
+        }
+        if (it == items.end() || pendingQueries.count(it->first))
+        {
+            // Either not yet queried (Will be up to date anyways) or not registered with us
+            return;
         }
-        if (clientsToQuery.size() > 0)
+
+        it->second.pendingRefresh |= refresh;
+        if (!refreshSourceID)
         {
-            InvalidateWidget();
+            refreshSourceID = g_idle_add(FlushRefreshes, nullptr);
         }
-        clientsToQuery.clear();
-        return TimerResult::Ok;
     }
 
-    // SNI implements the GTK-Thingies itself internally
-    static void InvalidateWidget()
+    static GtkMenu* GetMenu(Item& item)
     {
-        LOG("SNI: Clearing old children");
-        parentBox->RemoveChild(iconBox);
-
-        // Allow further updates from the icon
-        reloadedNames.clear();
-
-        auto container = Widget::Create<Box>();
-        container->SetSpacing({4, false});
-        container->SetOrientation(Utils::GetOrientation());
-        Utils::SetTransform(*container, {-1, true, Alignment::Fill, 0, 8});
-        iconBox = container.get();
-
-        // Sort items, so they don't jump around randomly
-        std::sort(items.begin(), items.end(),
-                  [](const Item& a, const Item& b)
-                  {
-                      return a.name < b.name;
-                  });
+        if (!item.menu && item.menuObjectPath.size() && item.gtkEvent && item.gtkEvent->Get())
+        {
+            LOG("SNI: Creating menu of " << item.name << " " << item.menuObjectPath);
+            item.menu = (GtkMenu*)dbusmenu_gtkmenu_new(item.name.data(), item.menuObjectPath.data());
+            g_object_ref_sink(item.menu);
+            gtk_menu_attach_to_widget(item.menu, item.gtkEvent->Get(), nullptr);
+        }
+        return item.menu;
+    }
 
-        for (auto& item : items)
+    // Top padding of the icon, as configured by SNIPaddingTop
+    static int GetPaddingTop(const std::string& tooltip)
+    {
+        bool wasExplicitOverride = false;
+        int paddingTop = 0;
+        for (auto& [filter, padding] : Config::Get().sniPaddingTop)
         {
-            if (item.iconData)
+            if (tooltip.find(filter) != std::string::npos)
             {
-                auto eventBox = Widget::Create<EventBox>();
-                item.gtkEvent = eventBox.get();
+                wasExplicitOverride = true;
+                paddingTop = padding;
+            }
+            else if (filter == "*" && !wasExplicitOverride)
+            {
+                paddingTop = padding;
+            }
+        }
+        return paddingTop;
+    }
 
-                eventBox->SetOnCreate(
-                    [&](Widget& w)
-                    {
-                        auto clickFn = [](GtkWidget*, GdkEventButton* event, void* data) -> gboolean
-                        {
-                            if (event->button == 1)
-                            {
-                                Item* item = (Item*)data;
-
-                                GtkMenu* menu = (GtkMenu*)dbusmenu_gtkmenu_new(item->name.data(), item->menuObjectPath.data());
-                                LOG(menu);
-                                gtk_menu_attach_to_widget(menu, item->gtkEvent->Get(), nullptr);
-                                gtk_menu_popup_at_pointer(menu, (GdkEvent*)event);
-                                LOG(item->menuObjectPath << " click");
-                            }
-                            return GDK_EVENT_STOP;
-                        };
-                        g_signal_connect(w.Get(), "button-release-event", G_CALLBACK(+clickFn), &item);
-                    });
-
-                LOG("SNI: Add " << item.name << " to widget");
-                auto texture = Widget::Create<Texture>();
-                bool wasExplicitOverride = false;
-                int size = 24;
-                for (auto& [filter, iconSize] : Config::Get().sniIconSizes)
+    // SNI implements the GTK-Thingies itself internally
+    static void AddItemWidget(Item& item)
+    {
+        auto eventBox = Widget::Create<EventBox>();
+        item.gtkEvent = eventBox.get();
+
+        eventBox->SetOnCreate(
+            [&](Widget& w)
+            {
+                auto clickFn = [](GtkWidget*, GdkEventButton* event, void* data) -> gboolean
                 {
-                    if (item.tooltip.find(filter) != std::string::npos)
-                    {
-                        wasExplicitOverride = true;
-                        size = iconSize;
-                    }
-                    else if (filter == "*" && !wasExplicitOverride)
+                    if (event->button == 1)
                     {
-                        size = iconSize;
+                        Item* item = (Item*)data;
+                        GtkMenu* menu = GetMenu(*item);
+                        if (menu)
+                        {
+                            gtk_menu_popup_at_pointer(menu, (GdkEvent*)event);
+                        }
+                        LOG(item->menuObjectPath << " click");
                     }
-                }
-                wasExplicitOverride = false;
-                for (auto& [filter, padding] : Config::Get().sniPaddingTop)
+                    return GDK_EVENT_STOP;
+                };
+                g_signal_connect(w.Get(), "button-release-event", G_CALLBACK(+clickFn), &item);
+            });
+        // Fetch the layout while the pointer is on the way to click, so the menu is complete when it pops up
+        eventBox->SetHoverFn(
+            [&](EventBox&, bool hovered)
+            {
+                if (hovered)
                 {
-                    if (item.tooltip.find(filter) != std::string::npos)
-                    {
-                        wasExplicitOverride = true;
-                        texture->AddPaddingTop(padding);
-                    }
-                    else if (filter == "*" && !wasExplicitOverride)
-                    {
-                        texture->AddPaddingTop(padding);
-                    }
+                    GetMenu(item);
                 }
-                Utils::SetTransform(*texture, {size, true, Alignment::Fill}, {size, true, Alignment::Fill});
-                texture->SetBuf(item.w, item.h, item.iconData);
-                texture->SetTooltip(item.tooltip);
-                texture->SetAngle(Utils::GetAngle() == 270 ? 90 : 0);
+            });
+
+        LOG("SNI: Add " << item.name << " to widget");
+        auto texture = Widget::Create<Texture>();
+        item.texture = texture.get();
+        item.widgetSize = GetIconSize(item.tooltip);
+        item.widgetPadding = GetPaddingTop(item.tooltip);
+        texture->AddPaddingTop(item.widgetPadding);
+        Utils::SetTransform(*texture, {item.widgetSize, true, Alignment::Fill}, {item.widgetSize, true, Alignment::Fill});
+        texture->SetSurface(GetSurface(item, item.widgetSize, GetScaleFactor()));
+        texture->SetTooltip(item.tooltip);
+        texture->SetAngle(Utils::GetAngle() == 270 ? 90 : 0);
+        eventBox->AddChild(std::move(texture));
+
+        // Insert at the position of the item in the map
+        size_t position = 0;
+        for (auto& [name, other] : items)
+        {
+            if (&other == &item)
+                break;
+            if (other.gtkEvent)
+                position++;
+        }
+        iconBox->AddChild(std::move(eventBox));
+        iconBox->ReorderChild(item.gtkEvent, position);
+    }
+
+    static void RemoveItemWidget(Item& item)
+    {
+        if (!item.gtkEvent)
+        {
+            return;
+        }
+        LOG("SNI: Remove " << item.name << " from widget");
+        // The menu is attached to the widget
+        FreeMenu(item);
+        iconBox->RemoveChild(item.gtkEvent);
+        item.gtkEvent = nullptr;
+        item.texture = nullptr;
+    }
+
+    // Brings the widgets of a single item up to date. The other items are not touched.
+    static void UpdateItemWidget(Item& item)
+    {
+        if (!iconBox)
+        {
+            // No tray in the layout
+            return;
+        }
+
+        if (!item.icon)
+        {
+            RemoveItemWidget(item);
+            return;
+        }
+        if (item.gtkEvent && (item.widgetSize != GetIconSize(item.tooltip) || item.widgetPadding != GetPaddingTop(item.tooltip)))
+        {
+            // The tooltip changed the layout of the icon
+            RemoveItemWidget(item);
+        }
+        if (!item.gtkEvent)
+        {
+            AddItemWidget(item);
+            return;
+        }
 
-                eventBox->AddChild(std::move(texture));
-                iconBox->AddChild(std::move(eventBox));
+        // Same layout, only swap what is drawn
+        item.texture->SetSurface(GetSurface(item, item.widgetSize, GetScaleFactor()));
+        item.texture->SetTooltip(item.tooltip);
+    }
+
+    // The color of the tray changes with the CSS and the gtk theme
+    static void UpdateSymbolicIcons()
+    {
+        uint32_t color = GetForegroundColor();
+        if (color == symbolicColor)
+        {
+            return;
+        }
+        symbolicColor = color;
+        for (auto& [name, item] : items)
+        {
+            if (item.symbolicPath.empty())
+            {
+                continue;
+            }
+            GdkPixbuf* icon = IconTheme::LoadSVG(item.symbolicPath, GetIconSize(item.tooltip) * GetScaleFactor(), color);
+            if (!icon)
+            {
+                continue;
             }
+            // Like ApplyRefresh: The old icon stays alive until the widget has the new one, so the new surface can't get its address
+            GdkPixbuf* oldIcon = item.icon;
+            cairo_surface_t* oldSurface = item.surface;
+            item.icon = icon;
+            item.surface = nullptr;
+            UpdateItemWidget(item);
+            if (oldIcon)
+                g_object_unref(oldIcon);
+            if (oldSurface)
+                cairo_surface_destroy(oldSurface);
         }
-        parentBox->AddChild(std::move(container));
     }
 
     void WidgetSNI(Widget& parent)
@@ -516,10 +837,33 @@ namespace SNI
         auto box = Widget::Create<Box>();
         Utils::SetTransform(*box, {-1, false, Alignment::Fill});
         auto container = Widget::Create<Box>();
-        container->AddTimer<Box>(UpdateWidgets, 1000, TimerDispatchBehaviour::LateDispatch);
+        container->SetSpacing({4, false});
+        container->SetOrientation(Utils::GetOrientation());
+        Utils::SetTransform(*container, {-1, true, Alignment::Fill, 0, 8});
+        container->SetOnCreate(
+            [](Widget& w)
+            {
+                auto styleUpdated = [](GtkWidget*, void*)
+                {
+                    UpdateSymbolicIcons();
+                };
+                g_signal_connect(w.Get(), "style-updated", G_CALLBACK(+styleUpdated), nullptr);
+                // Items, which registered before, were drawn without the style of the tray. Once the children are created too.
+                g_idle_add(
+                    [](void*) -> gboolean
+                    {
+                        UpdateSymbolicIcons();
+                        return G_SOURCE_REMOVE;
+                    },
+                    nullptr);
+            });
         iconBox = container.get();
         parentBox = box.get();
-        InvalidateWidget();
+        // Items, which registered before the bar was created
+        for (auto& [name, item] : items)
+        {
+            UpdateItemWidget(item);
+        }
         box->AddChild(std::move(container));
         parent.AddChild(std::move(box));
     }
@@ -541,12 +885,8 @@ namespace SNI
             name = service;
             object = "/StatusNotifierItem";
         }
-        auto it = std::find_if(items.begin(), items.end(),
-                               [&](const Item& item)
-                               {
-                                   return item.name == name && item.object == object;
-                               });
-        if (it != items.end())
+        auto it = items.find(name);
+        if (it != items.end() && it->second.object == object)
         {
             LOG("Rejecting " << name << " " << object);
             return false;
@@ -554,7 +894,7 @@ namespace SNI
         sni_watcher_emit_status_notifier_item_registered(watcher, service);
         sni_watcher_complete_register_status_notifier_item(watcher, invocation);
         LOG("SNI: Registered Item " << name << " " << object);
-        clientsToQuery[name] = {name, std::move(object)};
+        QueryItem(name, object);
         return true;
     }
 
@@ -580,29 +920,35 @@ namespace SNI
             return;
         }
 
-        auto busAcquired = [](GDBusConnection* connection, const char*, void*)
+        dbusConnection = DBus::Get(DBus::Bus::Session);
+        if (!dbusConnection)
         {
-            GError* err = nullptr;
-            g_dbus_interface_skeleton_export((GDBusInterfaceSkeleton*)watcherSkeleton, connection, "/StatusNotifierWatcher", &err);
-            if (err)
-            {
-                LOG("SNI: Failed to connect to dbus! Disabling SNI. Error: " << err->message);
-                RuntimeConfig::Get().hasSNI = false;
-                g_error_free(err);
-                return;
-            }
-            dbusConnection = connection;
+            LOG("SNI: Failed to connect to dbus! Disabling SNI.");
+            RuntimeConfig::Get().hasSNI = false;
+            return;
+        }
+
+        watcherSkeleton = sni_watcher_skeleton_new();
+        GError* err = nullptr;
+        g_dbus_interface_skeleton_export((GDBusInterfaceSkeleton*)watcherSkeleton, dbusConnection, "/StatusNotifierWatcher", &err);
+        if (err)
+        {
+            LOG("SNI: Failed to connect to dbus! Disabling SNI. Error: " << err->message);
+            RuntimeConfig::Get().hasSNI = false;
+            g_error_free(err);
+            return;
+        }
 
-            // Connect methods and signals
-            g_signal_connect(watcherSkeleton, "handle-register-status-notifier-item", G_CALLBACK(RegisterItem), nullptr);
-            g_signal_connect(watcherSkeleton, "handle-register-status-notifier-host", G_CALLBACK(RegisterHost), nullptr);
+        // Only items send signals on this interface, so it's fine to not filter by sender on the bus
+        itemSignalsID = DBus::Subscribe(DBus::Bus::Session, nullptr, "org.kde.StatusNotifierItem", nullptr, nullptr, ItemSignal);
 
-            g_signal_connect(watcherSkeleton, "status-notifier-item-registered", G_CALLBACK(ItemRegistered), nullptr);
-            g_signal_connect(watcherSkeleton, "status-notifier-item-unregistered", G_CALLBACK(ItemUnregistered), nullptr);
+        // Connect methods and signals
+        g_signal_connect(watcherSkeleton, "handle-register-status-notifier-item", G_CALLBACK(RegisterItem), nullptr);
+        g_signal_connect(watcherSkeleton, "handle-register-status-notifier-host", G_CALLBACK(RegisterHost), nullptr);
+
+        g_signal_connect(watcherSkeleton, "status-notifier-item-registered", G_CALLBACK(ItemRegistered), nullptr);
+        g_signal_connect(watcherSkeleton, "status-notifier-item-unregistered", G_CALLBACK(ItemUnregistered), nullptr);
 
-            // Host is always available
-            sni_watcher_set_is_status_notifier_host_registered(watcherSkeleton, true);
-        };
         auto emptyCallback = [](GDBusConnection*, const char*, void*) {};
         auto lostName = [](GDBusConnection*, const char*, void*)
         {
@@ -610,19 +956,28 @@ namespace SNI
             RuntimeConfig::Get().hasSNI = false;
         };
         auto flags = G_BUS_NAME_OWNER_FLAGS_REPLACE;
-        g_bus_own_name(G_BUS_TYPE_SESSION, "org.kde.StatusNotifierWatcher", (GBusNameOwnerFlags)flags, +busAcquired, +emptyCallback, +lostName,
-                       nullptr, nullptr);
-        watcherSkeleton = sni_watcher_skeleton_new();
+        // The watcher is exported before we own the name, so items can register as soon as they see it
+        g_bus_own_name_on_connection(dbusConnection, "org.kde.StatusNotifierWatcher", (GBusNameOwnerFlags)flags, +emptyCallback, +lostName,
+                                     nullptr, nullptr);
 
         std::string hostName = "org.kde.StatusNotifierHost-" + std::to_string(getpid());
-        g_bus_own_name(G_BUS_TYPE_SESSION, hostName.c_str(), (GBusNameOwnerFlags)flags, +emptyCallback, +emptyCallback, +emptyCallback, nullptr,
-                       nullptr);
+        g_bus_own_name_on_connection(dbusConnection, hostName.c_str(), (GBusNameOwnerFlags)flags, +emptyCallback, +emptyCallback, nullptr,
+                                     nullptr);
 
         // Host is always available
         sni_watcher_set_is_status_notifier_host_registered(watcherSkeleton, true);
         sni_watcher_emit_status_notifier_host_registered(watcherSkeleton);
     }
 
-    void Shutdown() {}
+    void Shutdown()
+    {
+        DBus::Unsubscribe(itemSignalsID);
+        if (refreshSourceID)
+        {
+            g_source_remove(refreshSourceID);
+            refreshSourceID = 0;
+        }
+        IconTheme::Shutdown();
+    }
 }
 #endif
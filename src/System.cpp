@@ -3,11 +3,18 @@
 #include "NvidiaGPU.h"
 #include "AMDGPU.h"
 #include "PulseAudio.h"
+#include "BlueZ.h"
+#include "DBus.h"
+#include "UPower.h"
+#include "Logind.h"
+#include "MPRIS.h"
+#include "Systemd.h"
 #include "Workspaces.h"
 #include "Config.h"
 #include "SNI.h"
 #include "Wayland.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <fstream>
 #include <mutex>
@@ -35,6 +42,12 @@ namespace System
     static CPUTimestamp curCPUTime;
     static CPUTimestamp prevCPUTime;
 
+    // Better safe than sorry. Isn't 32bit max only a few GB?
+    static uint64_t prevUploadBytes = UINT64_MAX;
+    static uint64_t prevDownloadBytes = UINT64_MAX;
+
+    static bool sleeping = false;
+
     double GetCPUUsage()
     {
         // Gather curCPUTime
@@ -91,6 +104,11 @@ namespace System
 
     double GetBatteryPercentage()
     {
+        if (RuntimeConfig::Get().hasUPower)
+        {
+            return UPower::GetInfo().percentage;
+        }
+
         std::ifstream fullChargeFile(Config::Get().batteryFolder + "/charge_full");
         std::ifstream currentChargeFile(Config::Get().batteryFolder + "/charge_now");
         if (fullChargeFile.is_open() && currentChargeFile.is_open())
@@ -116,6 +134,20 @@ namespace System
         return -1;
     }
 
+    const BatteryInfo& GetBatteryInfo()
+    {
+        if (RuntimeConfig::Get().hasUPower)
+        {
+            return UPower::GetInfo();
+        }
+
+        // No change notifications from sysfs, so every call is a change
+        static BatteryInfo info;
+        info.percentage = GetBatteryPercentage();
+        info.revision++;
+        return info;
+    }
+
     RAMInfo GetRAMInfo()
     {
         RAMInfo out{};
@@ -214,211 +246,31 @@ namespace System
     }
 
 #ifdef WITH_BLUEZ
-    void InitBluetooth()
-    {
-        // Try connecting to d-bus and org.bluez
-        GDBusConnection* connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, nullptr);
-        if (!connection)
-        {
-            LOG("Can't connect to d-bus! Disabling Bluetooth!");
-            // dbus not found, disable bluetooth
-            RuntimeConfig::Get().hasBlueZ = false;
-        }
-
-        GError* err = nullptr;
-        GVariant* objects = g_dbus_connection_call_sync(connection, "org.bluez", "/", "org.freedesktop.DBus.ObjectManager", "GetManagedObjects",
-                                                        nullptr, G_VARIANT_TYPE("(a{oa{sa{sv}}})"), G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &err);
-        if (!objects)
-        {
-            LOG("Can't connect to BlueZ d-bus! Disabling Bluetooth!");
-            LOG(err->message);
-            g_error_free(err);
-            // Not found, disable bluetooth
-            RuntimeConfig::Get().hasBlueZ = false;
-        }
-    }
-    BluetoothInfo GetBluetoothInfo()
+    const BluetoothInfo& GetBluetoothInfo()
     {
-        BluetoothInfo out{};
         if (!RuntimeConfig::Get().hasBlueZ)
         {
             LOG("Error: GetBluetoothInfo called, but bluetooth isn't available");
-            return out;
-        }
-        // Init D-Bus
-        GDBusConnection* connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, nullptr);
-        ASSERT(connection, "Failed to connect to d-bus!");
-
-        GError* err = nullptr;
-        GVariant* objects = g_dbus_connection_call_sync(connection, "org.bluez", "/", "org.freedesktop.DBus.ObjectManager", "GetManagedObjects",
-                                                        nullptr, G_VARIANT_TYPE("(a{oa{sa{sv}}})"), G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &err);
-        if (!objects)
-        {
-            LOG(err->message);
-            g_error_free(err);
-            exit(-1);
-        }
-
-        // First array
-        GVariantIter* topArray;
-        g_variant_get(objects, "(a{oa{sa{sv}}})", &topArray);
-
-        // Iterate the objects
-        GVariantIter* objectDescs;
-        while (g_variant_iter_next(topArray, "{oa{sa{sv}}}", NULL, &objectDescs))
-        {
-            // Iterate the descs
-            char* type = nullptr;
-            GVariantIter* propIter;
-            while (g_variant_iter_next(objectDescs, "{sa{sv}}", &type, &propIter))
-            {
-                if (strstr(type, "org.bluez.Adapter1"))
-                {
-                    std::string adapterName;
-                    bool powered = false;
-
-                    // This is a controller/adapter -> The "host"
-                    char* str = nullptr;
-                    GVariant* var = nullptr;
-                    while (g_variant_iter_next(propIter, "{sv}", &str, &var))
-                    {
-                        if (strstr(str, "Name"))
-                        {
-                            const char* name = g_variant_get_string(var, nullptr);
-                            // Copy it for us
-                            adapterName = name;
-                        }
-                        else if (strstr(str, "Powered"))
-                        {
-                            powered = g_variant_get_boolean(var);
-                        }
-                        g_free(str);
-                        g_variant_unref(var);
-                    }
-                    if (powered)
-                    {
-                        out.defaultController = std::move(adapterName);
-                    }
-                }
-                else if (strstr(type, "org.bluez.Device1"))
-                {
-                    std::string deviceMac;
-                    std::string deviceName;
-                    std::string deviceType;
-                    bool connected = false;
-                    bool paired = false;
-
-                    // This is a device -> One "client"
-                    char* str = nullptr;
-                    GVariant* var = nullptr;
-                    while (g_variant_iter_next(propIter, "{sv}", &str, &var))
-                    {
-                        if (strcmp(str, "Address") == 0)
-                        {
-                            const char* mac = g_variant_get_string(var, nullptr);
-                            // Copy it for us
-                            deviceMac = mac;
-                        }
-                        else if (strstr(str, "Name"))
-                        {
-                            const char* name = g_variant_get_string(var, nullptr);
-                            // Copy it for us
-                            deviceName = name;
-                        }
-                        else if (strstr(str, "Icon"))
-                        {
-                            const char* icon = g_variant_get_string(var, nullptr);
-                            // Copy it for us
-                            deviceType = icon;
-                        }
-                        else if (strstr(str, "Connected"))
-                        {
-                            connected = g_variant_get_boolean(var);
-                        }
-                        else if (strstr(str, "Paired"))
-                        {
-                            paired = g_variant_get_boolean(var);
-                        }
-                        g_free(str);
-                        g_variant_unref(var);
-                    }
-                    out.devices.push_back(BluetoothDevice{connected, paired, std::move(deviceMac), std::move(deviceName), std::move(deviceType)});
-                }
-                g_variant_iter_free(propIter);
-                g_free(type);
-            }
-            g_variant_iter_free(objectDescs);
         }
-
-        g_variant_iter_free(topArray);
-        g_variant_unref(objects);
-
-        return out;
+        return BlueZ::GetInfo();
     }
 
-    static Process btctlProcess{-1};
     void StartBTScan()
     {
-        StopBTScan();
-        btctlProcess = OpenProcess("/bin/sh -c \"bluetoothctl scan on\"");
+        BlueZ::StartDiscovery();
     }
     void StopBTScan()
     {
-        if (btctlProcess.pid != -1)
-        {
-            // Ctrl-C stops bluetoothctl
-            kill(btctlProcess.pid, SIGINT);
-            btctlProcess = {-1};
-        }
+        BlueZ::StopDiscovery();
     }
 
-    void ConnectBTDevice(BluetoothDevice& device, std::function<void(bool, BluetoothDevice&)> onFinish)
+    void ConnectBTDevice(const BluetoothDevice& device, std::function<void(bool, const BluetoothDevice&)> onFinish)
     {
-        auto thread = [&, mac = device.mac, onFinish]()
-        {
-            // 1. Pair
-            if (!device.paired)
-            {
-                int success = system(("bluetoothctl pair " + mac).c_str());
-                if (success != 0)
-                {
-                    onFinish(false, device);
-                    return;
-                }
-            }
-            // 2. Connect
-            if (!device.connected)
-            {
-                int success = system(("bluetoothctl connect " + mac).c_str());
-                if (success != 0)
-                {
-                    onFinish(false, device);
-                    return;
-                }
-            }
-            onFinish(true, device);
-        };
-        std::thread worker(thread);
-        worker.detach();
+        BlueZ::ConnectDevice(device, std::move(onFinish));
     }
-    void DisconnectBTDevice(BluetoothDevice& device, std::function<void(bool, BluetoothDevice&)> onFinish)
+    void DisconnectBTDevice(const BluetoothDevice& device, std::function<void(bool, const BluetoothDevice&)> onFinish)
     {
-        auto thread = [&, mac = device.mac, onFinish]()
-        {
-            // 1. Disconnect
-            if (device.connected)
-            {
-                int success = system(("bluetoothctl disconnect " + mac).c_str());
-                if (success != 0)
-                {
-                    onFinish(false, device);
-                    return;
-                }
-            }
-            onFinish(true, device);
-        };
-        std::thread worker(thread);
-        worker.detach();
+        BlueZ::DisconnectDevice(device, std::move(onFinish));
     }
 
     void OpenBTWidget()
@@ -460,6 +312,44 @@ namespace System
     {
         PulseAudio::SetVolumeSource(volume);
     }
+    const std::vector<AudioRecorder>& GetAudioRecorders(uint32_t& revision)
+    {
+        return PulseAudio::GetSourceOutputs(revision);
+    }
+    const std::vector<AudioStream>& GetAudioStreams(uint32_t& revision)
+    {
+        return PulseAudio::GetSinkInputs(revision);
+    }
+    void SetVolumeStream(uint32_t index, double volume)
+    {
+        PulseAudio::SetVolumeSinkInput(index, volume);
+    }
+    void SetMutedStream(uint32_t index, bool muted)
+    {
+        PulseAudio::SetMutedSinkInput(index, muted);
+    }
+
+    const MediaInfo& GetMediaInfo()
+    {
+        return MPRIS::GetInfo();
+    }
+    void MediaPlayPause()
+    {
+        MPRIS::CallPlayer("PlayPause");
+    }
+    void MediaNext()
+    {
+        MPRIS::CallPlayer("Next");
+    }
+    void MediaPrevious()
+    {
+        MPRIS::CallPlayer("Previous");
+    }
+
+    const FailedUnitsInfo& GetFailedUnitsInfo()
+    {
+        return Systemd::GetInfo();
+    }
 
 #ifdef WITH_WORKSPACES
     void PollWorkspaces(uint32_t monitor, uint32_t numWorkspaces)
@@ -535,8 +425,6 @@ namespace System
 
     double GetNetworkBpsUpload(double dt)
     {
-        // Better safe than sorry. Isn't 32bit max only a few GB?
-        static uint64_t prevUploadBytes = UINT64_MAX;
         // Apparently /sys/class/net/.../statistics/[t/r]x_bytes is valid for all net devices under Linux
         // https://www.kernel.org/doc/Documentation/ABI/testing/sysfs-class-net-statistics
         return GetNetworkBpsCommon(dt, prevUploadBytes, "/sys/class/net/" + Config::Get().networkAdapter + "/statistics/tx_bytes");
@@ -544,8 +432,6 @@ namespace System
 
     double GetNetworkBpsDownload(double dt)
     {
-        // Better safe than sorry. Isn't 32bit max only a few GB?
-        static uint64_t prevDownloadBytes = UINT64_MAX;
         // Apparently /sys/class/net/.../statistics/[t/r]x_bytes is valid for all net devices under Linux
         // https://www.kernel.org/doc/Documentation/ABI/testing/sysfs-class-net-statistics
         return GetNetworkBpsCommon(dt, prevDownloadBytes, "/sys/class/net/" + Config::Get().networkAdapter + "/statistics/rx_bytes");
@@ -616,12 +502,12 @@ namespace System
 
     void Shutdown()
     {
-        system("shutdown 0");
+        Logind::PowerOff();
     }
 
     void Reboot()
     {
-        system("reboot");
+        Logind::Reboot();
     }
 
     void ExitWM()
@@ -636,9 +522,33 @@ namespace System
 
     void Suspend()
     {
+        if (Config::Get().suspendCommand.empty())
+        {
+            Logind::Suspend();
+            return;
+        }
         system(Config::Get().suspendCommand.c_str());
     }
 
+    bool IsSleeping()
+    {
+        return sleeping;
+    }
+
+    static void OnPrepareForSleep(bool start)
+    {
+        sleeping = start;
+        if (start)
+        {
+            return;
+        }
+        // The counters kept running (Or were reset) while asleep, so the deltas to the values from before the sleep are bogus.
+        // Start over, like after startup.
+        prevUploadBytes = UINT64_MAX;
+        prevDownloadBytes = UINT64_MAX;
+        GetCPUUsage();
+    }
+
     void Init()
     {
         Logging::Init();
@@ -660,11 +570,45 @@ namespace System
 #endif
 
 #ifdef WITH_BLUEZ
-        InitBluetooth();
+        BlueZ::Init();
 #endif
 
         PulseAudio::Init();
 
+        Logind::Init(OnPrepareForSleep);
+
+        // Only watch players and units, when they are shown
+        auto usesWidget = [](const std::string& name)
+        {
+            for (auto* widgets : {&Config::Get().widgetsLeft, &Config::Get().widgetsCenter, &Config::Get().widgetsRight})
+            {
+                if (std::find(widgets->begin(), widgets->end(), name) != widgets->end())
+                    return true;
+            }
+            return false;
+        };
+        if (usesWidget("Media"))
+        {
+            MPRIS::Init();
+        }
+        if (usesWidget("FailedUnits"))
+        {
+            Systemd::Init();
+        }
+
+        if (Config::Get().useUPower)
+        {
+            RuntimeConfig::Get().hasUPower = UPower::Init();
+            if (!RuntimeConfig::Get().hasUPower)
+            {
+                LOG("UPower not available! Falling back to the battery folder.");
+            }
+        }
+        else
+        {
+            RuntimeConfig::Get().hasUPower = false;
+        }
+
 #ifdef WITH_SNI
         SNI::Init();
 #endif
@@ -684,10 +628,16 @@ namespace System
 
 #ifdef WITH_BLUEZ
         StopBTScan();
+        BlueZ::Shutdown();
 #endif
 #ifdef WITH_SNI
         SNI::Shutdown();
 #endif
+        UPower::Shutdown();
+        Logind::Shutdown();
+        MPRIS::Shutdown();
+        Systemd::Shutdown();
+        DBus::Shutdown();
 
         Wayland::Shutdown();
 
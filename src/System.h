@@ -13,6 +13,27 @@ namespace System
 
     double GetBatteryPercentage();
 
+    struct BatteryPeripheral
+    {
+        std::string model;
+        double percentage;
+    };
+    struct BatteryInfo
+    {
+        // 0-1, -1 if there is no battery
+        double percentage = -1;
+        bool charging = false;
+        // In seconds, 0 if unknown
+        int64_t timeToEmpty = 0;
+        int64_t timeToFull = 0;
+        // Mice, keyboards, ... Only reported by UPower
+        std::vector<BatteryPeripheral> peripherals;
+        // Changes, whenever anything of the above changes
+        uint32_t revision = 0;
+    };
+    // When UPower is used, this is maintained from its signals. Otherwise the battery folder is read on every call.
+    const BatteryInfo& GetBatteryInfo();
+
     struct RAMInfo
     {
         double totalGiB;
@@ -53,20 +74,27 @@ namespace System
         std::string name;
         // Known types: input-[keyboard,mouse]; audio-headset
         std::string type;
+        // BlueZ object path
+        std::string path;
+        // From org.bluez.Battery1, -1 if the device doesn't report it
+        int32_t batteryPercentage = -1;
     };
 
     struct BluetoothInfo
     {
         std::string defaultController;
         std::vector<BluetoothDevice> devices;
+        // Changes, whenever anything of the above changes
+        uint32_t revision = 0;
     };
-    BluetoothInfo GetBluetoothInfo();
+    // Maintained from BlueZ signals, so it is cheap to call.
+    const BluetoothInfo& GetBluetoothInfo();
     void StartBTScan();
     void StopBTScan();
 
-    // MT functions, callback, is from different thread
-    void ConnectBTDevice(BluetoothDevice& device, std::function<void(bool, BluetoothDevice&)> onFinish);
-    void DisconnectBTDevice(BluetoothDevice& device, std::function<void(bool, BluetoothDevice&)> onFinish);
+    // Asynchronous, onFinish is called on the main thread once BlueZ has answered.
+    void ConnectBTDevice(const BluetoothDevice& device, std::function<void(bool, const BluetoothDevice&)> onFinish);
+    void DisconnectBTDevice(const BluetoothDevice& device, std::function<void(bool, const BluetoothDevice&)> onFinish);
 
     void OpenBTWidget();
 
@@ -85,6 +113,63 @@ namespace System
     void SetVolumeSink(double volume);
     void SetVolumeSource(double volume);
 
+    // An application, that is recording from a source (A PulseAudio source output)
+    struct AudioRecorder
+    {
+        uint32_t index;
+        std::string appName;
+        std::string icon;
+        bool corked;
+    };
+    // Maintained from PulseAudio events, so it is cheap to call. revision changes, whenever a recorder is added, removed or changed.
+    const std::vector<AudioRecorder>& GetAudioRecorders(uint32_t& revision);
+
+    // A playback stream of an application (A PulseAudio sink input)
+    struct AudioStream
+    {
+        uint32_t index;
+        std::string appName;
+        std::string icon;
+        double volume;
+        bool muted;
+        // Changes, whenever anything of this stream changes
+        uint32_t revision;
+    };
+    // Maintained from PulseAudio events. revision changes, whenever a stream is added, removed or changed.
+    const std::vector<AudioStream>& GetAudioStreams(uint32_t& revision);
+    void SetVolumeStream(uint32_t index, double volume);
+    void SetMutedStream(uint32_t index, bool muted);
+
+    // Current track of the active MPRIS player
+    struct MediaInfo
+    {
+        // Player name without the org.mpris.MediaPlayer2 prefix. Empty, if there is no player.
+        std::string player;
+        bool playing = false;
+        std::string title;
+        std::string artist;
+        // Usually file:// or http(s)://
+        std::string artUrl;
+        // Changes, whenever anything of the above changes
+        uint32_t revision = 0;
+    };
+    // Maintained from MPRIS signals, so it is cheap to call.
+    const MediaInfo& GetMediaInfo();
+    void MediaPlayPause();
+    void MediaNext();
+    void MediaPrevious();
+
+    // Failed units of the system and the user manager
+    struct FailedUnitsInfo
+    {
+        std::vector<std::string> systemUnits;
+        std::vector<std::string> userUnits;
+        // Changes, whenever a unit fails or recovers
+        uint32_t revision = 0;
+    };
+    // Maintained from systemd signals, so it is cheap to call.
+    const FailedUnitsInfo& GetFailedUnitsInfo();
+
 #ifdef WITH_WORKSPACES
     enum class WorkspaceStatus
     {
@@ -111,12 +196,16 @@ namespace System
 
     std::string GetTime();
 
+    // Shutdown, Reboot and Suspend go through logind
     void Shutdown();
     void Reboot();
     void ExitWM();
     void Lock();
     void Suspend();
 
+    // True between logind announcing sleep and the resume. Samplers should pause in this time.
+    bool IsSleeping();
+
     void Init();
     void FreeResources();
 }
@@ -0,0 +1,204 @@
+#pragma once
+#include "System.h"
+#include "Common.h"
+#include "DBus.h"
+
+#include <gio/gio.h>
+#include <cstring>
+#include <map>
+
+// Failed units of the system and the user manager. Loaded once with ListUnitsFiltered and then maintained from the manager signals,
+// so nothing happens until a unit changes its state.
+namespace Systemd
+{
+    constexpr const char* unitPathPrefix = "/org/freedesktop/systemd1/unit/";
+
+    struct Manager
+    {
+        DBus::Bus bus;
+        // Unit object path -> unit name
+        std::map<std::string, std::string> failed;
+
+        DBus::SubscriptionID unitRemovedID = 0;
+        DBus::SubscriptionID propertiesChangedID = 0;
+        DBus::SubscriptionID reloadingID = 0;
+    };
+    // System and user manager
+    static Manager managers[2] = {{DBus::Bus::System, {}}, {DBus::Bus::Session, {}}};
+
+    static System::FailedUnitsInfo info;
+    static bool dirty = true;
+
+    // Object paths are the unit names with everything except [A-Za-z0-9] escaped as _xx, e.g. foo_2dbar_2eservice -> foo-bar.service
+    inline std::string UnitNameFromPath(const char* path)
+    {
+        if (strncmp(path, unitPathPrefix, strlen(unitPathPrefix)) != 0)
+        {
+            return path;
+        }
+        std::string name;
+        for (const char* c = path + strlen(unitPathPrefix); *c; c++)
+        {
+            if (*c == '_' && g_ascii_isxdigit(c[1]) && g_ascii_isxdigit(c[2]))
+            {
+                name += (char)(g_ascii_xdigit_value(c[1]) << 4 | g_ascii_xdigit_value(c[2]));
+                c += 2;
+            }
+            else
+            {
+                name += *c;
+            }
+        }
+        return name;
+    }
+
+    inline void LoadFailed(Manager& manager)
+    {
+        // Only failed units, so the reply stays small
+        GVariantBuilder states;
+        g_variant_builder_init(&states, G_VARIANT_TYPE("as"));
+        g_variant_builder_add(&states, "s", "failed");
+        DBus::Call(manager.bus, "org.freedesktop.systemd1", "/org/freedesktop/systemd1", "org.freedesktop.systemd1.Manager", "ListUnitsFiltered",
+                   g_variant_new("(as)", &states), G_VARIANT_TYPE("(a(ssssssouso))"),
+                   [&manager](GVariant* reply)
+                   {
+                       if (!reply)
+                       {
+                           return;
+                       }
+                       manager.failed.clear();
+                       GVariantIter* units = nullptr;
+                       g_variant_get(reply, "(a(ssssssouso))", &units);
+                       const char* name = nullptr;
+                       const char* path = nullptr;
+                       while (g_variant_iter_next(units, "(&s&s&s&s&s&s&ou&s&o)", &name, nullptr, nullptr, nullptr, nullptr, nullptr, &path,
+                                                  nullptr, nullptr, nullptr))
+                       {
+                           manager.failed[path] = name;
+                       }
+                       g_variant_iter_free(units);
+                       LOG("Systemd: " << manager.failed.size() << " failed units on the " << (manager.bus == DBus::Bus::System ? "system" : "user")
+                                       << " manager");
+                       dirty = true;
+                   });
+    }
+
+    inline void UnitRemoved(Manager& manager, GVariant* params)
+    {
+        const char* path = nullptr;
+        g_variant_get(params, "(&s&o)", nullptr, &path);
+        if (manager.failed.erase(path))
+        {
+            dirty = true;
+        }
+    }
+
+    inline void PropertiesChanged(Manager& manager, const char* path, GVariant* params)
+    {
+        const char* interface = nullptr;
+        GVariantIter* properties = nullptr;
+        g_variant_get(params, "(&sa{sv}as)", &interface, &properties, nullptr);
+        if (strcmp(interface, "org.freedesktop.systemd1.Unit") == 0)
+        {
+            const char* key = nullptr;
+            GVariant* value = nullptr;
+            while (g_variant_iter_next(properties, "{&sv}", &key, &value))
+            {
+                if (strcmp(key, "ActiveState") == 0)
+                {
+                    bool failed = strcmp(g_variant_get_string(value, nullptr), "failed") == 0;
+                    auto it = manager.failed.find(path);
+                    if (failed && it == manager.failed.end())
+                    {
+                        manager.failed[path] = UnitNameFromPath(path);
+                        dirty = true;
+                    }
+                    else if (!failed && it != manager.failed.end())
+                    {
+                        manager.failed.erase(it);
+                        dirty = true;
+                    }
+                }
+                g_variant_unref(value);
+            }
+        }
+        g_variant_iter_free(properties);
+    }
+
+    inline void Init()
+    {
+        for (Manager& manager : managers)
+        {
+            if (!DBus::Get(manager.bus))
+            {
+                continue;
+            }
+
+            // UnitNew needs no handling: New units are never failed, they will send PropertiesChanged when they fail.
+            manager.unitRemovedID = DBus::Subscribe(manager.bus, "org.freedesktop.systemd1", "org.freedesktop.systemd1.Manager", "UnitRemoved",
+                                                    "/org/freedesktop/systemd1",
+                                                    [&manager](const char*, const char*, const char*, const char*, GVariant* params)
+                                                    {
+                                                        UnitRemoved(manager, params);
+                                                    });
+            manager.propertiesChangedID =
+                DBus::Subscribe(manager.bus, "org.freedesktop.systemd1", "org.freedesktop.DBus.Properties", "PropertiesChanged", nullptr,
+                                [&manager](const char*, const char* path, const char*, const char*, GVariant* params)
+                                {
+                                    PropertiesChanged(manager, path, params);
+                                });
+            // After a daemon-reload units may have changed without signals
+            manager.reloadingID = DBus::Subscribe(manager.bus, "org.freedesktop.systemd1", "org.freedesktop.systemd1.Manager", "Reloading",
+                                                  "/org/freedesktop/systemd1",
+                                                  [&manager](const char*, const char*, const char*, const char*, GVariant* params)
+                                                  {
+                                                      gboolean active = false;
+                                                      g_variant_get(params, "(b)", &active);
+                                                      if (!active)
+                                                      {
+                                                          LoadFailed(manager);
+                                                      }
+                                                  });
+
+            // systemd only emits unit signals while at least one client is subscribed
+            DBus::CallVoid(manager.bus, "org.freedesktop.systemd1", "/org/freedesktop/systemd1", "org.freedesktop.systemd1.Manager", "Subscribe",
+                           nullptr);
+            LoadFailed(manager);
+        }
+    }
+
+    inline const System::FailedUnitsInfo& GetInfo()
+    {
+        if (!dirty)
+        {
+            return info;
+        }
+        dirty = false;
+
+        info.systemUnits.clear();
+        info.userUnits.clear();
+        for (auto& [path, name] : managers[0].failed)
+        {
+            info.systemUnits.push_back(name);
+        }
+        for (auto& [path, name] : managers[1].failed)
+        {
+            info.userUnits.push_back(name);
+        }
+        info.revision++;
+        return info;
+    }
+
+    inline void Shutdown()
+    {
+        // systemd drops our Subscribe, once the connection closes
+        for (Manager& manager : managers)
+        {
+            DBus::Unsubscribe(manager.unitRemovedID);
+            DBus::Unsubscribe(manager.propertiesChangedID);
+            DBus::Unsubscribe(manager.reloadingID);
+            manager.unitRemovedID = manager.propertiesChangedID = manager.reloadingID = 0;
+            manager.failed.clear();
+        }
+    }
+}
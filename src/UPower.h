@@ -0,0 +1,250 @@
+#pragma once
+#include "System.h"
+#include "Common.h"
+#include "Config.h"
+#include "DBus.h"
+
+#include <gio/gio.h>
+#include <cstring>
+#include <map>
+
+// Mirror of the UPower devices, maintained from DeviceAdded, DeviceRemoved and PropertiesChanged.
+// Reading the battery state therefore never touches d-bus or sysfs.
+namespace UPower
+{
+    // https://upower.freedesktop.org/docs/Device.html
+    enum class DeviceType
+    {
+        LinePower = 1,
+        Battery = 2,
+        UPS = 3,
+    };
+    enum class DeviceState
+    {
+        Charging = 1,
+        Discharging = 2,
+        FullyCharged = 4,
+    };
+
+    struct Device
+    {
+        uint32_t type = 0;
+        uint32_t state = 0;
+        bool powerSupply = false;
+        bool present = true;
+        std::string model;
+        double percentage = 0;
+        // Wh and W
+        double energy = 0;
+        double energyFull = 0;
+        double energyRate = 0;
+    };
+
+    // Keyed by object path
+    static std::map<std::string, Device> devices;
+
+    static System::BatteryInfo info;
+    static bool dirty = true;
+
+    static DBus::SubscriptionID deviceAddedID = 0;
+    static DBus::SubscriptionID deviceRemovedID = 0;
+    static DBus::SubscriptionID propertiesChangedID = 0;
+
+    // Init runs before the bar is shown, so a hanging UPower must not hold it up for the default d-bus timeout
+    constexpr int32_t enumerateTimeoutMS = 500;
+
+    inline void ApplyProperties(Device& device, GVariantIter* properties)
+    {
+        const char* key = nullptr;
+        GVariant* value = nullptr;
+        while (g_variant_iter_next(properties, "{&sv}", &key, &value))
+        {
+            if (strcmp(key, "Type") == 0)
+                device.type = g_variant_get_uint32(value);
+            else if (strcmp(key, "State") == 0)
+                device.state = g_variant_get_uint32(value);
+            else if (strcmp(key, "PowerSupply") == 0)
+                device.powerSupply = g_variant_get_boolean(value);
+            else if (strcmp(key, "IsPresent") == 0)
+                device.present = g_variant_get_boolean(value);
+            else if (strcmp(key, "Model") == 0)
+                device.model = g_variant_get_string(value, nullptr);
+            else if (strcmp(key, "Percentage") == 0)
+                device.percentage = g_variant_get_double(value);
+            else if (strcmp(key, "Energy") == 0)
+                device.energy = g_variant_get_double(value);
+            else if (strcmp(key, "EnergyFull") == 0)
+                device.energyFull = g_variant_get_double(value);
+            else if (strcmp(key, "EnergyRate") == 0)
+                device.energyRate = g_variant_get_double(value);
+            g_variant_unref(value);
+        }
+        dirty = true;
+    }
+
+    inline void LoadDevice(const std::string& path)
+    {
+        DBus::Call(DBus::Bus::System, "org.freedesktop.UPower", path.c_str(), "org.freedesktop.DBus.Properties", "GetAll",
+                   g_variant_new("(s)", "org.freedesktop.UPower.Device"), G_VARIANT_TYPE("(a{sv})"),
+                   [path](GVariant* reply)
+                   {
+                       if (!reply)
+                       {
+                           return;
+                       }
+                       GVariantIter* properties = nullptr;
+                       g_variant_get(reply, "(a{sv})", &properties);
+                       ApplyProperties(devices[path], properties);
+                       g_variant_iter_free(properties);
+                   });
+    }
+
+    inline void DeviceAdded(const char*, const char*, const char*, const char*, GVariant* params)
+    {
+        const char* path = nullptr;
+        g_variant_get(params, "(&o)", &path);
+        LoadDevice(path);
+    }
+
+    inline void DeviceRemoved(const char*, const char*, const char*, const char*, GVariant* params)
+    {
+        const char* path = nullptr;
+        g_variant_get(params, "(&o)", &path);
+        devices.erase(path);
+        dirty = true;
+    }
+
+    inline void PropertiesChanged(const char*, const char* path, const char*, const char*, GVariant* params)
+    {
+        const char* interface = nullptr;
+        GVariantIter* properties = nullptr;
+        g_variant_get(params, "(&sa{sv}as)", &interface, &properties, nullptr);
+        if (strcmp(interface, "org.freedesktop.UPower.Device") == 0)
+        {
+            auto it = devices.find(path);
+            if (it != devices.end())
+            {
+                ApplyProperties(it->second, properties);
+            }
+        }
+        g_variant_iter_free(properties);
+    }
+
+    inline void Shutdown()
+    {
+        DBus::Unsubscribe(deviceAddedID);
+        DBus::Unsubscribe(deviceRemovedID);
+        DBus::Unsubscribe(propertiesChangedID);
+        deviceAddedID = 0;
+        deviceRemovedID = 0;
+        propertiesChangedID = 0;
+    }
+
+    inline bool Init()
+    {
+        GDBusConnection* connection = DBus::Get(DBus::Bus::System);
+        if (!connection)
+        {
+            return false;
+        }
+
+        // Subscribe before the initial load, so we don't miss anything in between
+        deviceAddedID = DBus::Subscribe(DBus::Bus::System, "org.freedesktop.UPower", "org.freedesktop.UPower", "DeviceAdded", nullptr, DeviceAdded);
+        deviceRemovedID =
+            DBus::Subscribe(DBus::Bus::System, "org.freedesktop.UPower", "org.freedesktop.UPower", "DeviceRemoved", nullptr, DeviceRemoved);
+        propertiesChangedID =
+            DBus::Subscribe(DBus::Bus::System, "org.freedesktop.UPower", "org.freedesktop.DBus.Properties", "PropertiesChanged", nullptr, PropertiesChanged);
+
+        // Blocking, since the caller falls back to the battery folder without UPower. The devices are loaded asynchronously.
+        GError* err = nullptr;
+        GVariant* paths =
+            g_dbus_connection_call_sync(connection, "org.freedesktop.UPower", "/org/freedesktop/UPower", "org.freedesktop.UPower", "EnumerateDevices",
+                                        nullptr, G_VARIANT_TYPE("(ao)"), G_DBUS_CALL_FLAGS_NONE, enumerateTimeoutMS, nullptr, &err);
+        if (!paths)
+        {
+            LOG("UPower: Can't enumerate devices: " << err->message);
+            g_error_free(err);
+            Shutdown();
+            return false;
+        }
+
+        GVariantIter* pathIter = nullptr;
+        g_variant_get(paths, "(ao)", &pathIter);
+        const char* path = nullptr;
+        while (g_variant_iter_next(pathIter, "&o", &path))
+        {
+            LoadDevice(path);
+        }
+        g_variant_iter_free(pathIter);
+        g_variant_unref(paths);
+        return true;
+    }
+
+    inline const System::BatteryInfo& GetInfo()
+    {
+        if (!dirty)
+        {
+            return info;
+        }
+        dirty = false;
+
+        // Batteries powering the system (Laptop batteries, UPS) are combined weighted by their energy, so a nearly empty small battery
+        // doesn't drag down a full big one. Peripherals are listed on their own.
+        double energy = 0;
+        double energyFull = 0;
+        double chargeRate = 0;
+        double dischargeRate = 0;
+        double percentageSum = 0;
+        uint32_t numSupplies = 0;
+        bool charging = false;
+        info.peripherals.clear();
+        for (auto& [path, device] : devices)
+        {
+            if (!device.present || device.type == (uint32_t)DeviceType::LinePower)
+            {
+                continue;
+            }
+            if (!device.powerSupply && device.type != (uint32_t)DeviceType::UPS)
+            {
+                if (device.type != (uint32_t)DeviceType::Battery)
+                {
+                    info.peripherals.push_back({device.model, device.percentage / 100});
+                }
+                continue;
+            }
+
+            numSupplies++;
+            percentageSum += device.percentage / 100;
+            energy += device.energy;
+            energyFull += device.energyFull;
+            if (device.state == (uint32_t)DeviceState::Charging)
+            {
+                chargeRate += device.energyRate;
+                charging = true;
+            }
+            else if (device.state == (uint32_t)DeviceState::Discharging)
+            {
+                dischargeRate += device.energyRate;
+            }
+        }
+
+        if (numSupplies == 0)
+        {
+            info.percentage = -1;
+        }
+        else if (energyFull > 0)
+        {
+            info.percentage = energy / energyFull;
+        }
+        else
+        {
+            // No energy reported, fall back to the average
+            info.percentage = percentageSum / numSupplies;
+        }
+        info.charging = charging;
+        info.timeToEmpty = dischargeRate > 0 ? (int64_t)(energy / dischargeRate * 3600) : 0;
+        info.timeToFull = chargeRate > 0 ? (int64_t)((energyFull - energy) / chargeRate * 3600) : 0;
+        info.revision++;
+        return info;
+    }
+}
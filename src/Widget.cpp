@@ -1,6 +1,7 @@
 #include "Widget.h"
 #include "Common.h"
 #include "CSS.h"
+#include "Image.h"
 
 #include <cmath>
 
@@ -198,6 +199,24 @@ void Box::SetSpacing(Spacing spacing)
     m_Spacing = spacing;
 }
 
+void Box::ReorderChild(Widget* child, size_t position)
+{
+    auto it = std::find_if(m_Childs.begin(), m_Childs.end(),
+                           [&](std::unique_ptr<Widget>& other)
+                           {
+                               return other.get() == child;
+                           });
+    ASSERT(it != m_Childs.end(), "ReorderChild: Invalid child");
+    std::unique_ptr<Widget> moved = std::move(*it);
+    m_Childs.erase(it);
+    position = std::min(position, m_Childs.size());
+    m_Childs.insert(m_Childs.begin() + position, std::move(moved));
+    if (m_Widget)
+    {
+        gtk_box_reorder_child((GtkBox*)m_Widget, child->Get(), position);
+    }
+}
+
 void Box::Create()
 {
     m_Widget = gtk_box_new(Utils::ToGtkOrientation(m_Orientation), m_Spacing.free);
@@ -320,6 +339,33 @@ Quad CairoArea::GetQuad()
     return q;
 }
 
+void Sensor::Create()
+{
+    CairoArea::Create();
+
+    auto styleUpdated = [](GtkWidget*, void* data)
+    {
+        ((Sensor*)data)->UpdateStyle();
+    };
+    g_signal_connect(m_Widget, "style-updated", G_CALLBACK(+styleUpdated), this);
+    UpdateStyle();
+}
+
+void Sensor::UpdateStyle()
+{
+    auto style = gtk_widget_get_style_context(m_Widget);
+    GdkRGBA* bgCol;
+    GdkRGBA* fgCol;
+    gtk_style_context_get(style, GTK_STATE_FLAG_NORMAL, GTK_STYLE_PROPERTY_BACKGROUND_COLOR, &bgCol, NULL);
+    gtk_style_context_get(style, GTK_STATE_FLAG_NORMAL, GTK_STYLE_PROPERTY_COLOR, &fgCol, NULL);
+    m_BgColor = *bgCol;
+    m_FgColor = *fgCol;
+    gdk_rgba_free(bgCol);
+    gdk_rgba_free(fgCol);
+
+    gtk_widget_queue_draw(m_Widget);
+}
+
 void Sensor::SetValue(double val)
 {
     if (val != m_Val)
@@ -337,64 +383,62 @@ void Sensor::SetStyle(SensorStyle style)
     m_Style = style;
 }
 
-void Sensor::Draw(cairo_t* cr)
+// Shared by Sensor and SensorCluster
+static void DrawRing(cairo_t* cr, const Quad& q, double val, const SensorStyle& style, const GdkRGBA& bgCol, const GdkRGBA& fgCol)
 {
-    Quad q = GetQuad();
-
     double xCenter = q.x + q.size / 2;
     double yCenter = q.y + q.size / 2;
-    double radius = (q.size / 2) - (m_Style.strokeWidth / 2);
-
-    double beg = m_Style.start * (M_PI / 180);
-    double angle = m_Val * 2 * M_PI;
+    double radius = (q.size / 2) - (style.strokeWidth / 2);
 
-    auto style = gtk_widget_get_style_context(m_Widget);
-    GdkRGBA* bgCol;
-    GdkRGBA* fgCol;
-    gtk_style_context_get(style, GTK_STATE_FLAG_NORMAL, GTK_STYLE_PROPERTY_BACKGROUND_COLOR, &bgCol, NULL);
-    gtk_style_context_get(style, GTK_STATE_FLAG_NORMAL, GTK_STYLE_PROPERTY_COLOR, &fgCol, NULL);
+    double beg = style.start * (M_PI / 180);
+    double angle = val * 2 * M_PI;
 
-    cairo_set_line_width(cr, m_Style.strokeWidth);
+    cairo_set_line_width(cr, style.strokeWidth);
 
     // Outer
-    cairo_set_source_rgb(cr, bgCol->red, bgCol->green, bgCol->blue);
+    cairo_set_source_rgb(cr, bgCol.red, bgCol.green, bgCol.blue);
     cairo_arc(cr, xCenter, yCenter, radius, 0, 2 * M_PI);
     cairo_stroke(cr);
 
     // Inner
-    cairo_set_source_rgb(cr, fgCol->red, fgCol->green, fgCol->blue);
+    cairo_set_source_rgb(cr, fgCol.red, fgCol.green, fgCol.blue);
     cairo_arc(cr, xCenter, yCenter, radius, beg, beg + angle);
     cairo_stroke(cr);
+}
 
-    gdk_rgba_free(bgCol);
-    gdk_rgba_free(fgCol);
+void Sensor::Draw(cairo_t* cr)
+{
+    DrawRing(cr, GetQuad(), m_Val, m_Style, m_BgColor, m_FgColor);
 }
 
-static std::string NetworkSensorPercentToCSS(double percent)
+// Suffixes of the css classes, in the order of the bands
+static const char* networkSensorBands[] = {"under", "low", "mid-low", "mid-high", "high", "over"};
+
+static size_t NetworkSensorPercentToBand(double percent)
 {
     if (percent <= 0.)
     {
-        return "under";
+        return 0;
     }
     else if (percent <= 0.25)
     {
-        return "low";
+        return 1;
     }
     else if (percent <= 0.50)
     {
-        return "mid-low";
+        return 2;
     }
     else if (percent <= 0.75)
     {
-        return "mid-high";
+        return 3;
     }
     else if (percent <= 1.)
     {
-        return "high";
+        return 4;
     }
     else
     {
-        return "over";
+        return 5;
     }
 }
 
@@ -407,32 +451,40 @@ void NetworkSensor::Create()
 {
     CairoArea::Create();
 
-    // Add virtual children for style context(I know, it is really gross)
-    contextUp = Widget::Create<Box>();
-    contextUp->SetSpacing({0, true});
-    contextUp->SetClass("network-up-under");
-    contextUp->SetHorizontalTransform({0, false, Alignment::Fill});
-    contextUp->Create();
-
-    contextDown = Widget::Create<Box>();
-    contextDown->SetSpacing({0, true});
-    contextDown->SetClass("network-down-under");
-    contextDown->SetHorizontalTransform({0, false, Alignment::Fill});
-    contextDown->Create();
+    auto styleUpdated = [](GtkWidget*, void* data)
+    {
+        ((NetworkSensor*)data)->UpdateStyle();
+    };
+    g_signal_connect(m_Widget, "style-updated", G_CALLBACK(+styleUpdated), this);
+    UpdateStyle();
 }
 
-void NetworkSensor::SetUp(double val)
+void NetworkSensor::UpdateStyle()
 {
-    if (!contextUp)
+    static_assert(sizeof(networkSensorBands) / sizeof(networkSensorBands[0]) == s_NumBands);
+
+    // Temporarily add each class to our own context, instead of restyling widgets every tick
+    auto style = gtk_widget_get_style_context(m_Widget);
+    auto resolve = [&](const std::string& cssClass, GdkRGBA& color)
     {
-        return;
+        gtk_style_context_save(style);
+        gtk_style_context_add_class(style, cssClass.c_str());
+        gtk_style_context_get_color(style, GTK_STATE_FLAG_NORMAL, &color);
+        gtk_style_context_restore(style);
+    };
+    for (size_t i = 0; i < s_NumBands; i++)
+    {
+        resolve(std::string("network-up-") + networkSensorBands[i], m_ColorsUp[i]);
+        resolve(std::string("network-down-") + networkSensorBands[i], m_ColorsDown[i]);
     }
 
-    up = NetworkSensorRateToPercent(val, limitUp);
+    gtk_widget_queue_draw(m_Widget);
+}
 
-    // Add css class
-    std::string newClass = NetworkSensorPercentToCSS(up);
-    contextUp->SetClass("network-up-" + newClass);
+void NetworkSensor::SetUp(double val)
+{
+    up = NetworkSensorRateToPercent(val, limitUp);
+    m_BandUp = NetworkSensorPercentToBand(up);
 
     // Schedule redraw
     if (m_Widget)
@@ -443,16 +495,8 @@ void NetworkSensor::SetUp(double val)
 
 void NetworkSensor::SetDown(double val)
 {
-    if (!contextDown)
-    {
-        return;
-    }
-
     down = NetworkSensorRateToPercent(val, limitDown);
-
-    // Add css class
-    std::string newClass = NetworkSensorPercentToCSS(down);
-    contextDown->SetClass("network-down-" + newClass);
+    m_BandDown = NetworkSensorPercentToBand(down);
 
     // Schedule redraw
     if (m_Widget)
@@ -471,10 +515,8 @@ void NetworkSensor::Draw(cairo_t* cr)
         return q.size * (virtPx / 24.f);
     };
 
-    GdkRGBA* colUp;
-    GdkRGBA* colDown;
-    gtk_style_context_get(gtk_widget_get_style_context(contextUp->Get()), GTK_STATE_FLAG_NORMAL, GTK_STYLE_PROPERTY_COLOR, &colUp, NULL);
-    gtk_style_context_get(gtk_widget_get_style_context(contextDown->Get()), GTK_STATE_FLAG_NORMAL, GTK_STYLE_PROPERTY_COLOR, &colDown, NULL);
+    const GdkRGBA& colUp = m_ColorsUp[m_BandUp];
+    const GdkRGBA& colDown = m_ColorsDown[m_BandDown];
 
     // Rotate around center of Quad
     cairo_translate(cr, q.x + q.size / 2, q.y + q.size / 2);
@@ -482,7 +524,7 @@ void NetworkSensor::Draw(cairo_t* cr)
     cairo_translate(cr, -(q.x + q.size / 2), -(q.y + q.size / 2));
 
     // Upload
-    cairo_set_source_rgb(cr, colUp->red, colUp->green, colUp->blue);
+    cairo_set_source_rgb(cr, colUp.red, colUp.green, colUp.blue);
 
     // Triangle
     cairo_move_to(cr, q.x + virtToPx(6), q.y + virtToPx(0));   // Top mid
@@ -497,7 +539,7 @@ void NetworkSensor::Draw(cairo_t* cr)
     cairo_fill(cr);
 
     // Download
-    cairo_set_source_rgb(cr, colDown->red, colDown->green, colDown->blue);
+    cairo_set_source_rgb(cr, colDown.red, colDown.green, colDown.blue);
 
     // Triangle
     cairo_move_to(cr, q.x + virtToPx(18), q.y + virtToPx(24)); // Bottom mid
@@ -510,17 +552,182 @@ void NetworkSensor::Draw(cairo_t* cr)
     // Go a bit below, to avoid gaps between tri and quad
     cairo_rectangle(cr, q.x + virtToPx(16), q.y + virtToPx(2), virtToPx(4), virtToPx(12 + epsilon));
     cairo_fill(cr);
+}
+
+void SensorCluster::Create()
+{
+    CairoArea::Create();
+
+    gtk_widget_add_events(m_Widget, GDK_POINTER_MOTION_MASK | GDK_LEAVE_NOTIFY_MASK);
+    auto motion = [](GtkWidget*, GdkEventMotion* event, void* data) -> gboolean
+    {
+        SensorCluster* cluster = (SensorCluster*)data;
+        cluster->SetHovered(cluster->RingAt(event->x, event->y));
+        return false;
+    };
+    auto leave = [](GtkWidget*, GdkEventCrossing*, void* data) -> gboolean
+    {
+        ((SensorCluster*)data)->SetHovered(-1);
+        return false;
+    };
+    auto queryTooltip = [](GtkWidget*, gint x, gint y, gboolean, GtkTooltip* tooltip, void* data) -> gboolean
+    {
+        SensorCluster* cluster = (SensorCluster*)data;
+        int32_t ring = cluster->RingAt(x, y);
+        if (ring < 0 || cluster->m_Rings[ring].tooltip.empty())
+        {
+            return false;
+        }
+        gtk_tooltip_set_text(tooltip, cluster->m_Rings[ring].tooltip.c_str());
+        // Queried again, once the pointer leaves the ring
+        GdkRectangle rect = cluster->GetRingRect(ring);
+        gtk_tooltip_set_tip_area(tooltip, &rect);
+        return true;
+    };
+    auto styleUpdated = [](GtkWidget*, void* data)
+    {
+        ((SensorCluster*)data)->UpdateStyle();
+    };
+    g_signal_connect(m_Widget, "motion-notify-event", G_CALLBACK(+motion), this);
+    g_signal_connect(m_Widget, "leave-notify-event", G_CALLBACK(+leave), this);
+    g_signal_connect(m_Widget, "query-tooltip", G_CALLBACK(+queryTooltip), this);
+    g_signal_connect(m_Widget, "style-updated", G_CALLBACK(+styleUpdated), this);
+
+    // The tooltips are per ring, not for the whole widget
+    gtk_widget_set_tooltip_markup(m_Widget, nullptr);
+    gtk_widget_set_has_tooltip(m_Widget, true);
+
+    int length = m_Rings.size() * m_RingSize + (m_Rings.size() ? (m_Rings.size() - 1) * m_Spacing : 0);
+    if (m_Orientation == Orientation::Horizontal)
+        gtk_widget_set_size_request(m_Widget, length, m_RingSize);
+    else
+        gtk_widget_set_size_request(m_Widget, m_RingSize, length);
+    UpdateStyle();
+}
+
+size_t SensorCluster::AddRing(const std::string& cssClass, SensorStyle style)
+{
+    Ring ring;
+    ring.cssClass = cssClass;
+    ring.style = style;
+    m_Rings.push_back(ring);
+    return m_Rings.size() - 1;
+}
+
+void SensorCluster::SetValue(size_t ring, double val)
+{
+    if (val == m_Rings[ring].val)
+    {
+        return;
+    }
+    m_Rings[ring].val = val;
+    if (m_Widget)
+    {
+        // Only the ring itself
+        GdkRectangle rect = GetRingRect(ring);
+        gtk_widget_queue_draw_area(m_Widget, rect.x, rect.y, rect.width, rect.height);
+    }
+}
+
+void SensorCluster::SetRingTooltip(size_t ring, const std::string& tooltip)
+{
+    if (tooltip == m_Rings[ring].tooltip)
+    {
+        return;
+    }
+    m_Rings[ring].tooltip = tooltip;
+    // An empty tooltip has to hide the one, which is still shown, even if the pointer already moved on
+    if (m_Widget && (m_Hovered == (int32_t)ring || tooltip.empty()))
+    {
+        gtk_widget_trigger_tooltip_query(m_Widget);
+    }
+}
+
+void SensorCluster::UpdateStyle()
+{
+    // Temporarily add each class to our own context, like NetworkSensor
+    auto style = gtk_widget_get_style_context(m_Widget);
+    for (Ring& ring : m_Rings)
+    {
+        gtk_style_context_save(style);
+        gtk_style_context_add_class(style, ring.cssClass.c_str());
+        GdkRGBA* bgCol;
+        gtk_style_context_get(style, GTK_STATE_FLAG_NORMAL, GTK_STYLE_PROPERTY_BACKGROUND_COLOR, &bgCol, NULL);
+        gtk_style_context_get_color(style, GTK_STATE_FLAG_NORMAL, &ring.fgColor);
+        ring.bgColor = *bgCol;
+        gdk_rgba_free(bgCol);
+        gtk_style_context_restore(style);
+    }
+
+    gtk_widget_queue_draw(m_Widget);
+}
+
+GdkRectangle SensorCluster::GetRingRect(size_t ring)
+{
+    GtkAllocation dim;
+    gtk_widget_get_allocation(m_Widget, &dim);
+    int offset = ring * (m_RingSize + m_Spacing);
+    if (m_Orientation == Orientation::Horizontal)
+    {
+        return {offset, 0, m_RingSize, dim.height};
+    }
+    return {0, offset, dim.width, m_RingSize};
+}
+
+int32_t SensorCluster::RingAt(double x, double y)
+{
+    for (size_t i = 0; i < m_Rings.size(); i++)
+    {
+        GdkRectangle rect = GetRingRect(i);
+        if (x >= rect.x && x < rect.x + rect.width && y >= rect.y && y < rect.y + rect.height)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
 
-    gdk_rgba_free(colUp);
-    gdk_rgba_free(colDown);
+void SensorCluster::SetHovered(int32_t ring)
+{
+    if (ring == m_Hovered)
+    {
+        return;
+    }
+    m_Hovered = ring;
+    if (m_HoverFn)
+    {
+        m_HoverFn(*this, ring);
+    }
+}
+
+void SensorCluster::Draw(cairo_t* cr)
+{
+    // Only the rings, which were invalidated
+    GdkRectangle clip;
+    bool hasClip = gdk_cairo_get_clip_rectangle(cr, &clip);
+    for (size_t i = 0; i < m_Rings.size(); i++)
+    {
+        GdkRectangle rect = GetRingRect(i);
+        if (hasClip && !gdk_rectangle_intersect(&rect, &clip, nullptr))
+        {
+            continue;
+        }
+        // Square and centered in the rect, like CairoArea::GetQuad
+        Quad q;
+        q.size = std::min(rect.width, rect.height);
+        q.x = rect.x + (rect.width - q.size) / 2.0;
+        q.y = rect.y + (rect.height - q.size) / 2.0;
+        const Ring& ring = m_Rings[i];
+        DrawRing(cr, q, ring.val, ring.style, ring.bgColor, ring.fgColor);
+    }
 }
 
 Texture::~Texture()
 {
     if (m_Pixbuf)
-        g_free(m_Pixbuf);
+        g_object_unref(m_Pixbuf);
     if (m_Bytes)
-        g_free(m_Bytes);
+        g_bytes_unref(m_Bytes);
 }
 
 void Texture::SetBuf(size_t width, size_t height, uint8_t* buf)
@@ -531,8 +738,30 @@ void Texture::SetBuf(size_t width, size_t height, uint8_t* buf)
     m_Pixbuf = gdk_pixbuf_new_from_bytes((GBytes*)m_Bytes, GDK_COLORSPACE_RGB, true, 8, m_Width, m_Height, m_Width * 4);
 }
 
+void Texture::SetSurface(cairo_surface_t* surface)
+{
+    if (surface == m_Surface)
+    {
+        return;
+    }
+    m_Surface = surface;
+    if (m_Surface)
+    {
+        m_Width = cairo_image_surface_get_width(m_Surface);
+        m_Height = cairo_image_surface_get_height(m_Surface);
+    }
+    if (m_Widget)
+    {
+        gtk_widget_queue_draw(m_Widget);
+    }
+}
+
 void Texture::Draw(cairo_t* cr)
 {
+    if (!m_Surface && !m_Pixbuf)
+    {
+        return;
+    }
     Quad q = GetQuad();
 
     // TODO: Non-quad sizes
@@ -560,7 +789,14 @@ void Texture::Draw(cairo_t* cr)
 
     cairo_scale(cr, scaleX, scaleY);
 
-    gdk_cairo_set_source_pixbuf(cr, m_Pixbuf, (q.x + paddingX) * (1.0 / scaleY), (q.y + paddingY) * (1.0 / scaleY));
+    if (m_Surface)
+    {
+        cairo_set_source_surface(cr, m_Surface, (q.x + paddingX) * (1.0 / scaleX), (q.y + paddingY) * (1.0 / scaleY));
+    }
+    else
+    {
+        gdk_cairo_set_source_pixbuf(cr, m_Pixbuf, (q.x + paddingX) * (1.0 / scaleY), (q.y + paddingY) * (1.0 / scaleY));
+    }
     cairo_fill(cr);
 }
 
@@ -582,11 +818,36 @@ void Revealer::SetRevealed(bool revealed)
     gtk_revealer_set_reveal_child((GtkRevealer*)m_Widget, revealed);
 }
 
+// Rendered rotated texts, keyed by style, scale and text. Shared by all Text widgets, so e.g. workspace symbols are only rendered once.
+static Image::SurfaceCache textCache(128);
+
+static bool IsVertical(double angle)
+{
+    return std::fmod(std::abs(angle), 180) == 90;
+}
+
+Text::~Text()
+{
+    if (m_Layout)
+        g_object_unref(m_Layout);
+    if (m_Surface)
+        cairo_surface_destroy(m_Surface);
+}
+
 void Text::SetText(const std::string& text)
 {
     if (m_Widget && text != m_Text)
     {
-        gtk_label_set_text((GtkLabel*)m_Widget, text.c_str());
+        if (m_Layout)
+        {
+            m_Text = text;
+            UpdateSize();
+            gtk_widget_queue_draw(m_Widget);
+        }
+        else
+        {
+            gtk_label_set_text((GtkLabel*)m_Widget, text.c_str());
+        }
     }
     m_Text = text;
 }
@@ -595,21 +856,212 @@ void Text::SetAngle(double angle)
 {
     if (m_Widget && angle != m_Angle)
     {
-        gtk_label_set_angle((GtkLabel*)m_Widget, angle);
+        if (m_Layout)
+        {
+            m_Angle = angle;
+            UpdateSize();
+            gtk_widget_queue_draw(m_Widget);
+        }
+        else
+        {
+            gtk_label_set_angle((GtkLabel*)m_Widget, angle);
+        }
     }
     m_Angle = angle;
 }
 
+void Text::UpdateStyle()
+{
+    // The font may have changed
+    pango_layout_context_changed(m_Layout);
+
+    auto style = gtk_widget_get_style_context(m_Widget);
+    PangoFontDescription* font = nullptr;
+    gtk_style_context_get(style, gtk_style_context_get_state(style), GTK_STYLE_PROPERTY_FONT, &font, NULL);
+    char* fontStr = pango_font_description_to_string(font);
+    // Tabular figures look different
+    m_StyleKey = std::string(fontStr) + (m_StableTemplate.size() ? "|tnum" : "");
+    g_free(fontStr);
+    pango_font_description_free(font);
+
+    m_ReservedWidth = 0;
+    m_ReservedHeight = 0;
+    if (m_StableTemplate.size())
+    {
+        // Without tabular figures in the font, digits still differ in width
+        char widestDigit = '0';
+        int widestWidth = 0;
+        for (char digit = '0'; digit <= '9'; digit++)
+        {
+            int width = 0;
+            pango_layout_set_text(m_Layout, &digit, 1);
+            pango_layout_get_pixel_size(m_Layout, &width, nullptr);
+            if (width > widestWidth)
+            {
+                widestWidth = width;
+                widestDigit = digit;
+            }
+        }
+        std::string widest = m_StableTemplate;
+        for (char& c : widest)
+        {
+            if (g_ascii_isdigit(c))
+            {
+                c = widestDigit;
+            }
+        }
+        pango_layout_set_text(m_Layout, widest.c_str(), -1);
+        pango_layout_get_pixel_size(m_Layout, &m_ReservedWidth, &m_ReservedHeight);
+    }
+
+    // Also puts m_Text back into the layout
+    UpdateSize();
+    gtk_widget_queue_draw(m_Widget);
+}
+
+cairo_surface_t* Text::GetCachedSurface()
+{
+    // gtk_render_layout draws with the current state of the widget, which selects the color
+    auto style = gtk_widget_get_style_context(m_Widget);
+    GdkRGBA color;
+    gtk_style_context_get_color(style, gtk_style_context_get_state(style), &color);
+    char colorStr[32];
+    snprintf(colorStr, sizeof(colorStr), "%.3f,%.3f,%.3f,%.3f", color.red, color.green, color.blue, color.alpha);
+    int scale = gtk_widget_get_scale_factor(m_Widget);
+    std::string key = m_StyleKey + "|" + colorStr + "|" + std::to_string(scale) + "|" + m_Text;
+    if (m_StableTemplate.size())
+    {
+        if (m_Surface && m_SurfaceKey == key)
+        {
+            return m_Surface;
+        }
+    }
+    else if (cairo_surface_t* surface = textCache.Get(key))
+    {
+        return surface;
+    }
+
+    // Rendered unrotated from the layout, which UpdateSize shaped. Draw only rotates the finished pixels.
+    cairo_surface_t* surface =
+        cairo_image_surface_create(CAIRO_FORMAT_ARGB32, std::max(m_TextWidth, 1) * scale, std::max(m_TextHeight, 1) * scale);
+    cairo_surface_set_device_scale(surface, scale, scale);
+    cairo_t* cr = cairo_create(surface);
+    gtk_render_layout(style, cr, 0, 0, m_Layout);
+    cairo_destroy(cr);
+    if (m_StableTemplate.size())
+    {
+        if (m_Surface)
+            cairo_surface_destroy(m_Surface);
+        m_Surface = surface;
+        m_SurfaceKey = std::move(key);
+    }
+    else
+    {
+        textCache.Put(key, surface);
+    }
+    return surface;
+}
+
+void Text::UpdateSize()
+{
+    // Only shapes, a rotated text is rendered when it is drawn
+    pango_layout_set_text(m_Layout, m_Text.c_str(), -1);
+    pango_layout_get_pixel_size(m_Layout, &m_TextWidth, &m_TextHeight);
+    int width = m_TextWidth;
+    int height = m_TextHeight;
+    if (m_StableTemplate.size())
+    {
+        m_ReservedWidth = std::max(m_ReservedWidth, width);
+        m_ReservedHeight = std::max(m_ReservedHeight, height);
+        width = m_ReservedWidth;
+        height = m_ReservedHeight;
+    }
+
+    // Only queues a resize, if the size actually changed
+    if (IsVertical(m_Angle))
+    {
+        std::swap(width, height);
+    }
+    gtk_widget_set_size_request(m_Widget, std::max(m_HorizontalTransform.size, width), std::max(m_VerticalTransform.size, height));
+}
+
+void Text::Draw(cairo_t* cr)
+{
+    GtkAllocation dim;
+    gtk_widget_get_allocation(m_Widget, &dim);
+
+    // Centered like a GtkLabel, the angle is counter clockwise like gtk_label_set_angle. Whole pixels, so a rotated surface isn't blurred.
+    cairo_translate(cr, std::floor(dim.width / 2.0), std::floor(dim.height / 2.0));
+    cairo_rotate(cr, -m_Angle * M_PI / 180.0);
+    if (IsVertical(m_Angle))
+    {
+        cairo_surface_t* surface = GetCachedSurface();
+        int scale = gtk_widget_get_scale_factor(m_Widget);
+        int width = cairo_image_surface_get_width(surface) / scale;
+        int height = cairo_image_surface_get_height(surface) / scale;
+        cairo_set_source_surface(cr, surface, -std::floor(width / 2.0), -std::floor(height / 2.0));
+        cairo_paint(cr);
+    }
+    else
+    {
+        // Already shaped by UpdateSize
+        gtk_render_layout(gtk_widget_get_style_context(m_Widget), cr, -std::floor(m_TextWidth / 2.0), -std::floor(m_TextHeight / 2.0), m_Layout);
+    }
+}
+
 void Text::Create()
 {
-    m_Widget = gtk_label_new(m_Text.c_str());
-    gtk_label_set_angle((GtkLabel*)m_Widget, m_Angle);
+    if (m_StableTemplate.empty() && !(IsVertical(m_Angle) && Config::Get().cacheVerticalText))
+    {
+        m_Widget = gtk_label_new(m_Text.c_str());
+        gtk_label_set_angle((GtkLabel*)m_Widget, m_Angle);
+        ApplyPropertiesToWidget();
+        return;
+    }
+
+    m_Widget = gtk_drawing_area_new();
+    m_Layout = gtk_widget_create_pango_layout(m_Widget, m_Text.c_str());
+    if (m_StableTemplate.size())
+    {
+        PangoAttrList* attrs = pango_attr_list_new();
+        pango_attr_list_insert(attrs, pango_attr_font_features_new("tnum=1"));
+        pango_layout_set_attributes(m_Layout, attrs);
+        pango_attr_list_unref(attrs);
+    }
+
+    auto drawFn = [](GtkWidget*, cairo_t* cr, void* data) -> gboolean
+    {
+        ((Text*)data)->Draw(cr);
+        return false;
+    };
+    auto styleUpdated = [](GtkWidget*, void* data)
+    {
+        ((Text*)data)->UpdateStyle();
+    };
+    g_signal_connect(m_Widget, "draw", G_CALLBACK(+drawFn), this);
+    g_signal_connect(m_Widget, "style-updated", G_CALLBACK(+styleUpdated), this);
+
     ApplyPropertiesToWidget();
+    UpdateStyle();
 }
 
 void Button::Create()
 {
-    m_Widget = gtk_button_new_with_label(m_Text.c_str());
+    if (IsVertical(m_Angle) && Config::Get().cacheVerticalText)
+    {
+        // Our own Text instead of the label, so it can be drawn from the cache
+        m_Widget = gtk_button_new();
+        auto label = Widget::Create<Text>();
+        label->SetText(m_Text);
+        label->SetAngle(m_Angle);
+        m_Label = label.get();
+        // Created with the other children after us
+        m_Childs.push_back(std::move(label));
+    }
+    else
+    {
+        m_Widget = gtk_button_new_with_label(m_Text.c_str());
+    }
     auto clickFn = [](UNUSED GtkButton* gtkButton, void* data) -> gboolean
     {
         Button* button = (Button*)data;
@@ -632,7 +1084,11 @@ void Button::Create()
 
 void Button::SetText(const std::string& text)
 {
-    if (m_Widget && text != m_Text)
+    if (m_Label)
+    {
+        m_Label->SetText(text);
+    }
+    else if (m_Widget && text != m_Text)
     {
         gtk_button_set_label((GtkButton*)m_Widget, text.c_str());
     }
@@ -641,7 +1097,11 @@ void Button::SetText(const std::string& text)
 
 void Button::SetAngle(double angle)
 {
-    if (m_Widget && angle != m_Angle)
+    if (m_Label)
+    {
+        m_Label->SetAngle(angle);
+    }
+    else if (m_Widget && angle != m_Angle)
     {
         gtk_container_foreach((GtkContainer*)m_Widget,
                               [](GtkWidget* child, void* userData)
@@ -191,6 +191,9 @@ public:
     void SetOrientation(Orientation orientation);
     void SetSpacing(Spacing spacing);
 
+    // Moves child to position, without recreating it
+    void ReorderChild(Widget* child, size_t position);
+
     virtual void Create() override;
 
 private:
@@ -238,15 +241,22 @@ protected:
 class Sensor : public CairoArea
 {
 public:
+    virtual void Create() override;
+
     // Goes from 0-1
     void SetValue(double val);
     void SetStyle(SensorStyle style);
 
 private:
     void Draw(cairo_t* cr) override;
+    // Called on style-updated, so drawing doesn't need to query the style context
+    void UpdateStyle();
 
     double m_Val;
     SensorStyle m_Style{};
+
+    GdkRGBA m_BgColor{};
+    GdkRGBA m_FgColor{};
 };
 
 class NetworkSensor : public CairoArea
@@ -264,6 +274,8 @@ public:
 
 private:
     void Draw(cairo_t* cr) override;
+    // Called on style-updated, resolves the colors of all network-up-* and network-down-* classes
+    void UpdateStyle();
 
     // These are in percent
     double up, down;
@@ -273,10 +285,58 @@ private:
 
     double m_Angle;
 
-    // What I do here is a little bit gross, but I need a working style context
-    // Just manually creating a style context doesn't work for me.
-    std::unique_ptr<Box> contextUp;
-    std::unique_ptr<Box> contextDown;
+    // Indexed by band (under, low, mid-low, mid-high, high, over)
+    static constexpr size_t s_NumBands = 6;
+    GdkRGBA m_ColorsUp[s_NumBands]{};
+    GdkRGBA m_ColorsDown[s_NumBands]{};
+    size_t m_BandUp = 0;
+    size_t m_BandDown = 0;
+};
+
+// Draws the rings of several sensors in one drawing area, instead of one widget (and style context) per sensor.
+// Rings are laid out along the orientation, each size x size plus spacing. Changing a value only redraws its ring.
+class SensorCluster : public CairoArea
+{
+public:
+    virtual void Create() override;
+
+    // Before creation. Returns the index of the ring, cssClass provides the colors like for a Sensor.
+    size_t AddRing(const std::string& cssClass, SensorStyle style);
+    void SetOrientation(Orientation orientation) { m_Orientation = orientation; }
+    void SetRingSize(int size) { m_RingSize = size; }
+    void SetSpacing(int spacing) { m_Spacing = spacing; }
+
+    // Goes from 0-1
+    void SetValue(size_t ring, double val);
+    // Shown, while the pointer is on the ring
+    void SetRingTooltip(size_t ring, const std::string& tooltip);
+    // Called with the ring under the pointer, when it changes. -1 when the pointer left all rings.
+    void SetHoverFn(std::function<void(SensorCluster&, int32_t)>&& fn) { m_HoverFn = std::move(fn); }
+
+private:
+    struct Ring
+    {
+        std::string cssClass;
+        SensorStyle style;
+        double val = 0;
+        std::string tooltip;
+        GdkRGBA bgColor{};
+        GdkRGBA fgColor{};
+    };
+
+    void Draw(cairo_t* cr) override;
+    // Called on style-updated, resolves the colors of all ring classes
+    void UpdateStyle();
+    GdkRectangle GetRingRect(size_t ring);
+    int32_t RingAt(double x, double y);
+    void SetHovered(int32_t ring);
+
+    std::vector<Ring> m_Rings;
+    Orientation m_Orientation = Orientation::Horizontal;
+    int m_RingSize = 24;
+    int m_Spacing = 0;
+    int32_t m_Hovered = -1;
+    std::function<void(SensorCluster&, int32_t)> m_HoverFn;
 };
 
 class Texture : public CairoArea
@@ -285,8 +345,10 @@ public:
     Texture() = default;
     virtual ~Texture();
 
-    // Non-Owning, ARGB32
+    // Copies buf, RGBA32
     void SetBuf(size_t width, size_t height, uint8_t* buf);
+    // Non-Owning, drawn instead of the buffer. nullptr draws nothing.
+    void SetSurface(cairo_surface_t* surface);
 
     void ForceHeight(size_t height) { m_ForcedHeight = height; };
     void AddPaddingTop(int32_t topPadding) { m_Padding = topPadding; };
@@ -300,8 +362,9 @@ private:
     size_t m_ForcedHeight = 0;
     double m_Angle;
     int32_t m_Padding = 0;
-    GBytes* m_Bytes;
-    GdkPixbuf* m_Pixbuf;
+    GBytes* m_Bytes = nullptr;
+    GdkPixbuf* m_Pixbuf = nullptr;
+    cairo_surface_t* m_Surface = nullptr;
 };
 
 class Revealer : public Widget
@@ -321,16 +384,42 @@ class Text : public Widget
 {
 public:
     Text() = default;
-    virtual ~Text() = default;
+    virtual ~Text();
 
     void SetText(const std::string& text);
     void SetAngle(double angle);
+    // Opt-in, before creation: Reserves the size of templateText, in which every digit counts as the widest digit of the font, and
+    // draws digits as tabular figures. Changing the text then only redraws the widget instead of relayouting the whole bar.
+    // The reserved size only grows, if a text doesn't fit.
+    void SetStableWidth(const std::string& templateText) { m_StableTemplate = templateText; }
 
     virtual void Create() override;
 
 private:
+    // Stable width and rotated (With CacheVerticalText) texts are drawn by us on a drawing area. A GtkLabel queues a resize on every
+    // change, and shapes rotated layouts again on every text change.
+    void UpdateStyle();
+    // Shapes m_Text into the layout, which then keeps it for drawing
+    void UpdateSize();
+    // Rendering of a rotated text. Shared by all widgets with the same text and style, except for stable width texts.
+    cairo_surface_t* GetCachedSurface();
+    void Draw(cairo_t* cr);
+
     std::string m_Text;
     double m_Angle;
+
+    std::string m_StableTemplate;
+    PangoLayout* m_Layout = nullptr;
+    // Font, part of the cache key. The color is added at drawing time, it depends on the state (e.g. :hover).
+    std::string m_StyleKey;
+    // Unrotated size of m_Text
+    int m_TextWidth = 0;
+    int m_TextHeight = 0;
+    int m_ReservedWidth = 0;
+    int m_ReservedHeight = 0;
+    // Stable width texts are values, which change all the time. They get their own slot, so they don't evict the shared renderings.
+    cairo_surface_t* m_Surface = nullptr;
+    std::string m_SurfaceKey;
 };
 
 class Button : public Widget
@@ -350,6 +439,8 @@ private:
     std::string m_Text;
     double m_Angle;
     Callback<Button> m_OnClick;
+    // Replaces the label of the button, when the text is drawn rotated
+    Text* m_Label = nullptr;
 };
 
 class Slider : public Widget
@@ -4,15 +4,19 @@
 #include "Bar.h"
 #include "AudioFlyin.h"
 #include "BluetoothDevices.h"
+#include "AudioMixer.h"
 #include "Plugin.h"
 #include "Config.h"
+#include "DBus.h"
 
 #include <cmath>
 #include <cstdio>
 #include <unistd.h>
+#include <glib-unix.h>
 
 const char* audioTmpFilePath = "/tmp/gBar__audio";
 const char* bluetoothTmpFilePath = "/tmp/gBar__bluetooth";
+const char* mixerTmpFilePath = "/tmp/gBar__mixer";
 
 static bool tmpFileOpen = false;
 
@@ -39,6 +43,7 @@ void CloseTmpFiles(int sig)
     {
         remove(audioTmpFilePath);
         remove(bluetoothTmpFilePath);
+        remove(mixerTmpFilePath);
     }
     if (sig != 0)
         exit(1);
@@ -47,6 +52,15 @@ void CloseTmpFiles(int sig)
 int main(int argc, char** argv)
 {
     signal(SIGINT, CloseTmpFiles);
+    // kill -USR1 dumps the d-bus statistics, e.g. to compare runs against mock services on a private bus
+    g_unix_signal_add(
+        SIGUSR1,
+        [](void*) -> gboolean
+        {
+            DBus::LogStats();
+            return G_SOURCE_CONTINUE;
+        },
+        nullptr);
     System::Init();
 
     int32_t monitor = -1;
@@ -70,6 +84,22 @@ int main(int argc, char** argv)
     {
         OpenAudioFlyin(window, monitor, AudioFlyin::Type::Microphone);
     }
+    else if (strcmp(argv[1], "mixer") == 0)
+    {
+        if (access(mixerTmpFilePath, F_OK) != 0)
+        {
+            tmpFileOpen = true;
+            FILE* mixerTmpFile = fopen(mixerTmpFilePath, "w");
+            AudioMixer::Create(window, monitor);
+            fclose(mixerTmpFile);
+        }
+        else
+        {
+            // Already open, close
+            LOG("Mixer widget already open (/tmp/gBar__mixer exists)! Exiting...");
+            exit(0);
+        }
+    }
 #ifdef WITH_BLUEZ
     else if (strcmp(argv[1], "bluetooth") == 0)
     {